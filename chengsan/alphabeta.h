@@ -0,0 +1,365 @@
+//
+//  alphabeta.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef alphabeta_h
+#define alphabeta_h
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "board.h"
+#include "search.h"
+#include "threadpool.h"
+#include "utils.h"
+#include "tablebase.h"
+#include "ntuple.h"
+#include "ttable.h"
+#include "instrument.h"
+
+using namespace std;
+
+/*
+ Negamax alpha-beta search with iterative deepening. Steps are tried in the
+ order: best step from the transposition table, steps that make a san, the 2
+ killer steps of the ply, then by history score. Leaves are scored by the shared
+ n-tuple network when there is one, else by Evaluate.
+
+ With more than one thread the search is Lazy SMP: helper threads run the same
+ iterative deepening from the root, every other one a depth ahead and each with
+ its history scores salted differently, so they spread over the tree and fill
+ the shared transposition table for the others. Killers and history stay per
+ thread. The search ends when any thread finishes the last depth or a limit
+ is hit, and the deepest finished iteration of all threads is the result.
+ */
+class AlphaBetaPlayer {
+public:
+    static const int WIN_SCORE = 30000;
+    static const int MAX_PLY = 128;
+    static const int DEFAULT_DEPTH = 6;     // used when a search has no limit
+
+    AlphaBetaPlayer(int selfTag, int oTag, size_t ttMegabytes = 16, size_t threads = 1)
+    :tag(selfTag), opponentTag(oTag), tt(ttMegabytes), clock(SearchLimits()), nodes(0), stop(false), tablebase(NULL),
+    network(NULL) {
+        SetThreads(threads);
+    }
+
+    int Tag() const {
+        return tag;
+    }
+
+    // Threads a search runs on: the caller's and Threads() - 1 helpers
+    size_t Threads() const {
+        return workers.size();
+    }
+
+    void SetThreads(size_t threads) {
+        threads = max(threads, (size_t)1);
+        workers.clear();
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back(new Worker(i));
+        }
+        pool.reset(threads > 1 ? new ThreadPool(threads - 1) : nullptr);
+    }
+
+    // Nodes of every thread in the last search, the caller's first
+    vector<uint64_t> ThreadNodes() const {
+        vector<uint64_t> res;
+        for (auto& worker: workers) {
+            res.push_back(worker->nodes);
+        }
+        return res;
+    }
+
+    const TranspositionTable& Table() const {
+        return tt;
+    }
+
+    // Static score of board for playerTag to move in round
+    static int Evaluate(const Board& board, int playerTag, int round) {
+        int opponentTag = Board::Opponent(playerTag);
+        int score = 100 * (board.PieceNumber(playerTag) - board.PieceNumber(opponentTag));
+        score += 20 * (board.CountOpenSans(playerTag) - board.CountOpenSans(opponentTag));
+        if (round >= 9) {
+            score += 5 * (board.CountMoveSteps(playerTag) - board.CountMoveSteps(opponentTag));
+        }
+        return score;
+    }
+
+    Step Search(const Board& board, int round, const SearchLimits& limits = SearchLimits(), SearchInfo* info = NULL) {
+        INSTRUMENT_TRACE("AlphaBeta");
+        int maxDepth = limits.maxDepth > 0 ? limits.maxDepth : (limits.Unlimited() ? DEFAULT_DEPTH : MAX_PLY - 1);
+        clock = SearchClock(limits);
+        this->limits = limits;
+        nodes = 0;
+        stop = false;
+        tablebase = Tablebase::Shared();
+        network = NTupleNetwork::Shared();
+        tt.NewSearch();
+
+        MoveList steps;
+        board.FindPossibleSteps(tag, round, steps);
+        if (steps.empty()) {
+            if (info) {
+                clock.Finish(*info, 0, 0, false);
+                info->depth = 0;
+                info->score = -WIN_SCORE;
+            }
+            return Step::MakePlaceStep(tag, Step::NONE_POS);
+        }
+        for (auto& worker: workers) {
+            worker->Reset(steps[0]);
+        }
+        for (size_t i = 1; i < workers.size(); ++i) {
+            pool->Submit([this, &board, round, maxDepth, i](size_t) {
+                Iterate(*workers[i], board, round, maxDepth);
+            });
+        }
+        Iterate(*workers[0], board, round, maxDepth);
+        stop = true;
+        if (pool) {
+            pool->Wait();
+        }
+
+        // the deepest finished iteration, the caller's one among equals
+        const Worker* deepest = workers[0].get();
+        uint64_t total = 0;
+        for (auto& worker: workers) {
+            total += worker->nodes;
+            if (worker->depth > deepest->depth) {
+                deepest = worker.get();
+            }
+        }
+        if (info) {
+            bool finished = deepest->depth == maxDepth || abs(deepest->score) > WIN_SCORE - MAX_PLY;
+            clock.Finish(*info, 0, total, !finished);
+            info->depth = deepest->depth;
+            info->score = deepest->score;
+        }
+        return deepest->best;
+    }
+private:
+    static const int HELPER_SALT = 63;      // most history noise a helper adds to reorder steps
+
+    // What one search thread keeps to itself
+    struct Worker {
+        explicit Worker(size_t id)
+        :id(id) {
+            Reset(Step());
+        }
+
+        void Reset(const Step& step) {
+            nodes = 0;
+            depth = 0;
+            score = 0;
+            best = step;
+            memset(killers, 0xff, sizeof(killers));
+            memset(history, 0, sizeof(history));
+        }
+
+        size_t id;              // 0 is the caller
+        uint64_t nodes;
+        int depth, score;       // deepest finished iteration and its score
+        Step best;              // and its best step
+        uint16_t killers[MAX_PLY][2];
+        int history[3][24 * 24];
+    };
+
+    // Iterative deepening of one thread, helpers with an odd id start a depth ahead
+    void Iterate(Worker& worker, const Board& board, int round, int maxDepth) {
+        INSTRUMENT_TRACE(worker.id == 0 ? "AlphaBeta" : "AlphaBeta helper");
+        Board scratch = board;
+        for (int d = 1 + (int)(worker.id & 1); d <= maxDepth && !stop.load(memory_order_relaxed); ++d) {
+            INSTRUMENT_TRACE("AlphaBeta iteration");
+            Step iterationBest = worker.best;
+            int score = Negamax(worker, scratch, d, -WIN_SCORE - 1, WIN_SCORE + 1, tag, round, 0, &iterationBest);
+            if (stop.load(memory_order_relaxed)) {
+                break;
+            }
+            worker.best = iterationBest;
+            worker.score = score;
+            worker.depth = d;
+            // a forced win or loss will not change with more depth
+            if (abs(score) > WIN_SCORE - MAX_PLY) {
+                break;
+            }
+        }
+        // the others are done once one thread is
+        stop = true;
+    }
+
+    // Static score of a leaf for toMove
+    int Leaf(const Board& board, int toMove, int round) const {
+        if (network) {
+            INSTRUMENT_COUNT(EVALUATIONS, 1);
+            return network->Score(board, toMove, round);
+        }
+        return Evaluate(board, toMove, round);
+    }
+
+    // Score of the state for toMove, the best step is written to bestStep at the root
+    int Negamax(Worker& worker, Board& board, int depth, int alpha, int beta, int toMove, int round, int ply,
+                Step* bestStep) {
+        if ((++worker.nodes & 1023) == 0 && clock.Done(0, nodes.fetch_add(1024, memory_order_relaxed) + 1024)) {
+            stop = true;
+        }
+        if (stop.load(memory_order_relaxed)) {
+            return 0;
+        }
+        if (depth <= 0 || ply >= MAX_PLY) {
+            return Leaf(board, toMove, round);
+        }
+
+        Tablebase::Result result;
+        int distance;
+        if (ply > 0 && tablebase && tablebase->Probe(board, toMove, round, result, distance)) {
+            if (result == Tablebase::DRAW) {
+                return 0;
+            }
+            int score = WIN_SCORE - ply - distance;
+            return result == Tablebase::WIN ? score : -score;
+        }
+
+        uint64_t key = board.Hash(toMove, round);
+        TranspositionTable::Entry entry;
+        uint16_t ttMove = Step::NONE_CODE;
+        if (tt.Probe(key, entry)) {
+            ttMove = entry.move;
+            int value = FromTable(entry.value, ply);
+            if (ply > 0 && entry.depth >= depth) {
+                if (entry.bound == TranspositionTable::EXACT
+                    || (entry.bound == TranspositionTable::LOWER && value >= beta)
+                    || (entry.bound == TranspositionTable::UPPER && value <= alpha)) {
+                    return value;
+                }
+            }
+        }
+
+        MoveList steps;
+        board.FindPossibleSteps(toMove, round, steps);
+        if (steps.empty()) {
+            return Leaf(board, toMove, round);
+        }
+        Order(worker, steps, ttMove, toMove, ply);
+
+        int alphaOrigin = alpha, best = -WIN_SCORE - 1;
+        uint16_t bestMove = Step::NONE_CODE;
+        for (auto& step: steps) {
+            int score, winner;
+            StepUndo undo = board.DoStep(step, round);
+            if (board.IsOver(winner, round)) {
+                score = winner == toMove ? WIN_SCORE - ply - 1 : -(WIN_SCORE - ply - 1);
+            } else {
+                score = -Negamax(worker, board, depth - 1, -beta, -alpha, Board::Opponent(toMove),
+                                 Board::NextRound(toMove, round), ply + 1, NULL);
+            }
+            board.UndoStep(undo);
+            if (stop.load(memory_order_relaxed)) {
+                return 0;
+            }
+
+            if (score > best) {
+                best = score;
+                bestMove = step.Encode();
+                if (bestStep) {
+                    *bestStep = step;
+                }
+            }
+            if (score > alpha) {
+                alpha = score;
+            }
+            if (alpha >= beta) {
+                if (step.eatPos == Step::NONE_POS && step.Encode() != worker.killers[ply][0]) {
+                    worker.killers[ply][1] = worker.killers[ply][0];
+                    worker.killers[ply][0] = step.Encode();
+                }
+                worker.history[toMove][HistoryIndex(step)] += depth * depth;
+                break;
+            }
+        }
+
+        entry.value = ToTable(best, ply);
+        entry.move = bestMove;
+        entry.depth = (uint8_t)depth;
+        entry.bound = best <= alphaOrigin ? TranspositionTable::UPPER
+            : (best >= beta ? TranspositionTable::LOWER : TranspositionTable::EXACT);
+        tt.Store(key, entry);
+        return best;
+    }
+
+    // Insertion sort by score, stable and without allocating. Helpers salt the history scores.
+    void Order(const Worker& worker, MoveList& steps, uint16_t ttMove, int toMove, int ply) const {
+        int scores[MoveList::MAX_STEPS];
+        for (size_t i = 0; i < steps.size(); ++i) {
+            const Step& step = steps[i];
+            uint16_t code = step.Encode();
+            int score = worker.history[toMove][HistoryIndex(step)];
+            if (worker.id > 0) {
+                score += (int)(Utils::Mix(worker.id, code) & HELPER_SALT);
+            }
+            if (code == ttMove) {
+                score = 1 << 30;
+            } else if (step.eatPos != Step::NONE_POS) {
+                score = (1 << 29) + score;
+            } else if (code == worker.killers[ply][0] || code == worker.killers[ply][1]) {
+                score = (1 << 28) + (code == worker.killers[ply][0]);
+            }
+
+            size_t j = i;
+            Step moving = step;
+            for (; j > 0 && scores[j - 1] < score; --j) {
+                scores[j] = scores[j - 1];
+                steps[j] = steps[j - 1];
+            }
+            scores[j] = score;
+            steps[j] = moving;
+        }
+    }
+
+    // History is kept per (from or place, to) pair
+    static size_t HistoryIndex(const Step& step) {
+        if (step.type == Step::MOVE) {
+            return step.moveFrom * 24 + step.moveTo;
+        }
+        return step.placePos * 24 + step.placePos;
+    }
+
+    // Wins are stored relative to the node, not the root
+    static int16_t ToTable(int value, int ply) {
+        if (value > WIN_SCORE - MAX_PLY) {
+            return (int16_t)(value + ply);
+        } else if (value < -WIN_SCORE + MAX_PLY) {
+            return (int16_t)(value - ply);
+        }
+        return (int16_t)value;
+    }
+
+    static int FromTable(int value, int ply) {
+        if (value > WIN_SCORE - MAX_PLY) {
+            return value - ply;
+        } else if (value < -WIN_SCORE + MAX_PLY) {
+            return value + ply;
+        }
+        return value;
+    }
+
+    int tag;
+    int opponentTag;
+    TranspositionTable tt;
+    SearchLimits limits;
+    SearchClock clock;
+    atomic<uint64_t> nodes;         // of all threads, in steps of 1024 for the limits
+    atomic<bool> stop;
+    const Tablebase* tablebase;     // probed below the root, may be NULL
+    const NTupleNetwork* network;   // scores the leaves when it is not NULL
+    vector<unique_ptr<Worker>> workers;
+    unique_ptr<ThreadPool> pool;    // runs the helpers, NULL with one thread
+};
+
+#endif /* alphabeta_h */
@@ -0,0 +1,189 @@
+//
+//  arena.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef arena_h
+#define arena_h
+
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include "game.h"
+#include "threadpool.h"
+#include "utils.h"
+
+using namespace std;
+
+// Totals of a match, seen from engine A
+struct ArenaResult {
+    ArenaResult()
+    :games(0), wins(0), losses(0), draws(0) {
+    }
+
+    // Points of A per game, a draw is half a point
+    double Score() const {
+        return games ? (wins + 0.5 * draws) / games : 0.5;
+    }
+
+    // Elo difference of A over B for a score, clamped away from 0 and 1
+    static double Elo(double score) {
+        score = min(max(score, 1e-3), 1 - 1e-3);
+        return -400 * log10(1 / score - 1);
+    }
+
+    // Elo difference with its 95% confidence interval, from the variance of the game scores
+    void EloRange(double& elo, double& low, double& high) const {
+        double score = Score();
+        double variance = games ? (wins * (1 - score) * (1 - score) + draws * (0.5 - score) * (0.5 - score)
+                                   + losses * score * score) / games : 0;
+        double margin = games ? 1.96 * sqrt(variance / games) : 0;
+        elo = Elo(score);
+        low = Elo(score - margin);
+        high = Elo(score + margin);
+    }
+
+    uint64_t games, wins, losses, draws;
+    PlayerStats a, b;   // summed over the games, whichever side they played
+};
+
+/*
+ Plays a match of headless games between engine configs A and B, several games
+ at a time on a thread pool. A plays first in the even games, and game i is
+ seeded with Mix(seed, i), so a match is replayed by its seed whatever the
+ number of threads. Every finished game is written to a results file as a CSV
+ or JSONL line right away.
+ */
+class Arena {
+public:
+    enum Format {
+        CSV,
+        JSONL
+    };
+
+    Arena(const EngineConfig& a, const EngineConfig& b, uint64_t seed, int maxRounds = DEFAULT_MAX_ROUNDS)
+    :a(a), b(b), seed(seed), maxRounds(maxRounds), out(NULL), format(CSV), recorder(NULL) {
+    }
+
+    static const int DEFAULT_MAX_ROUNDS = 200;
+
+    // Stream a line per game to file, the caller keeps it open until Run returns
+    void SetOutput(FILE* file, Format f) {
+        out = file;
+        format = f;
+        if (out && format == CSV) {
+            fprintf(out, "game,seed,first,second,winner,rounds,a_ms_per_step,b_ms_per_step,a_playouts,b_playouts\n");
+            fflush(out);
+        }
+    }
+
+    // Append every game to recorder as it ends
+    void SetRecorder(GameRecorder* r) {
+        recorder = r;
+    }
+
+    ArenaResult Run(size_t games, size_t threads, FILE* progress = NULL) {
+        result = ArenaResult();
+        ThreadPool pool(max(threads, (size_t)1));
+        for (size_t i = 0; i < games; ++i) {
+            pool.Submit([this, i, progress](size_t) {
+                PlayGame(i, progress);
+            });
+        }
+        pool.Wait();
+        return result;
+    }
+
+    static void PrintSummary(const ArenaResult& result, const EngineConfig& a, const EngineConfig& b) {
+        double elo, low, high;
+        result.EloRange(elo, low, high);
+        printf("%s vs %s: %llu games, +%llu -%llu =%llu, score %.3f\n", EngineConfig::TypeName(a.type),
+               EngineConfig::TypeName(b.type), (unsigned long long)result.games, (unsigned long long)result.wins,
+               (unsigned long long)result.losses, (unsigned long long)result.draws, result.Score());
+        printf("Elo %+.1f (95%% %+.1f to %+.1f)\n", elo, low, high);
+        PrintStats("A", a, result.a);
+        PrintStats("B", b, result.b);
+    }
+private:
+    void PlayGame(size_t index, FILE* progress) {
+        uint64_t gameSeed = Utils::Mix(seed, index);
+        bool aFirst = index % 2 == 0;
+        Game game(gameSeed, aFirst ? a : b, aFirst ? b : a);
+        game.SetVerbose(false);
+        game.SetMaxRounds(maxRounds);
+        game.SetRecorder(recorder);
+        int winner = game.Run();
+
+        int aTag = aFirst ? Board::FIRST_TAG : Board::SECOND_TAG;
+        const PlayerStats& aStats = game.Stats(aTag);
+        const PlayerStats& bStats = game.Stats(Board::Opponent(aTag));
+
+        lock_guard<mutex> lock(mtx);
+        result.games++;
+        if (winner == 0) {
+            result.draws++;
+        } else if (winner == aTag) {
+            result.wins++;
+        } else {
+            result.losses++;
+        }
+        Merge(result.a, aStats);
+        Merge(result.b, bStats);
+
+        // the winner is written as a (engine A), b or draw
+        const char* winnerName = winner == 0 ? "draw" : (winner == aTag ? "a" : "b");
+        const char* firstName = aFirst ? "a" : "b";
+        const char* secondName = aFirst ? "b" : "a";
+        if (out && format == CSV) {
+            fprintf(out, "%zu,%llu,%s,%s,%s,%d,%.3f,%.3f,%llu,%llu\n", index, (unsigned long long)gameSeed, firstName,
+                    secondName, winnerName, game.Round(), MillisPerStep(aStats), MillisPerStep(bStats),
+                    (unsigned long long)aStats.playouts, (unsigned long long)bStats.playouts);
+        } else if (out) {
+            fprintf(out, "{\"game\":%zu,\"seed\":%llu,\"first\":\"%s\",\"second\":\"%s\",\"winner\":\"%s\",\"rounds\":%d,"
+                    "\"a_ms_per_step\":%.3f,\"b_ms_per_step\":%.3f,\"a_playouts\":%llu,\"b_playouts\":%llu}\n",
+                    index, (unsigned long long)gameSeed, firstName, secondName, winnerName, game.Round(),
+                    MillisPerStep(aStats), MillisPerStep(bStats), (unsigned long long)aStats.playouts,
+                    (unsigned long long)bStats.playouts);
+        }
+        if (out) {
+            fflush(out);
+        }
+        if (progress) {
+            fprintf(progress, "game %zu: %s wins after %d rounds (+%llu -%llu =%llu)\n", index, winnerName, game.Round(),
+                    (unsigned long long)result.wins, (unsigned long long)result.losses, (unsigned long long)result.draws);
+            fflush(progress);
+        }
+    }
+
+    static void Merge(PlayerStats& total, const PlayerStats& game) {
+        total.steps += game.steps;
+        total.micros += game.micros;
+        total.playouts += game.playouts;
+        total.nodes += game.nodes;
+    }
+
+    static double MillisPerStep(const PlayerStats& stats) {
+        return stats.steps ? stats.micros / 1000.0 / stats.steps : 0;
+    }
+
+    static void PrintStats(const char* name, const EngineConfig& config, const PlayerStats& stats) {
+        double seconds = stats.micros / 1e6;
+        printf("%s (%s): %.2f ms per step, %.0f playouts/s, %.0f nodes/s\n", name, EngineConfig::TypeName(config.type),
+               MillisPerStep(stats), seconds > 0 ? stats.playouts / seconds : 0, seconds > 0 ? stats.nodes / seconds : 0);
+    }
+
+    EngineConfig a, b;
+    uint64_t seed;
+    int maxRounds;
+    FILE* out;
+    Format format;
+    GameRecorder* recorder;
+    mutex mtx;
+    ArenaResult result;
+};
+
+#endif /* arena_h */
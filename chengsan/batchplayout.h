@@ -0,0 +1,424 @@
+//
+//  batchplayout.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef batchplayout_h
+#define batchplayout_h
+
+#include <cstdint>
+#include <cstring>
+#include "board.h"
+#include "instrument.h"
+#include "utils.h"
+
+using namespace std;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CHENGSAN_AVX2_KERNEL 1
+#endif
+
+// A game to finish with random steps: the board, who is to move and the round
+struct BatchGame {
+    Board board;
+    int toMove;
+    int round;
+};
+
+/*
+ Random playouts of LANES games at once. Every game is a lane of a few 8 x 32
+ bit vectors (GCC vector extensions), one per mask, and a ply is the same
+ straight line of mask operations for all of them: the neighbour shifts of
+ Board for the steps, popcounts and a select by binary search over partial
+ popcounts for the random choices, full line masks for sans. A lane whose game
+ ended takes the next game of the batch, so the lanes stay busy.
+
+ The kernel is compiled twice: for AVX2, picked at run time when the CPU has it,
+ and for the baseline target as the fallback. The policy is the one of
+ Player::Random: a uniform step (for moves, a uniform (from, to) pair) and a
+ uniform piece to eat, free pieces first. Each lane has its own xoshiro128**,
+ so the games differ from the scalar ones with the same seed, but their outcomes
+ follow the same distribution.
+ */
+class BatchPlayout {
+public:
+    static const int LANES = 8;
+    static const int MAX_PLIES = 200;   // like Player::Playout, then the one with more pieces wins
+
+    enum Kernel {
+        GENERIC,
+        AVX2
+    };
+
+    static bool HasAvx2() {
+#ifdef CHENGSAN_AVX2_KERNEL
+        static const bool has = __builtin_cpu_supports("avx2");
+        return has;
+#else
+        return false;
+#endif
+    }
+
+    static Kernel Best() {
+        return HasAvx2() ? AVX2 : GENERIC;
+    }
+
+    static const char* KernelName(Kernel kernel) {
+        return kernel == AVX2 ? "avx2" : "generic";
+    }
+
+    /*
+     Play the n games to their ends, winners[i] is the winner of games[i], 0 when
+     it was cut off with as many pieces on both sides. Returns the plies played.
+     */
+    static uint64_t Play(const BatchGame* games, int* winners, size_t n, uint64_t seed, Kernel kernel = Best()) {
+        INSTRUMENT_TIMER(ROLLOUT);
+        uint64_t plies;
+#ifdef CHENGSAN_AVX2_KERNEL
+        if (kernel == AVX2 && HasAvx2()) {
+            plies = PlayAvx2(games, winners, n, seed);
+        } else {
+            plies = PlayGeneric(games, winners, n, seed);
+        }
+#else
+        plies = PlayGeneric(games, winners, n, seed);
+#endif
+        INSTRUMENT_COUNT(PLAYOUTS, n);
+        INSTRUMENT_COUNT(PLAYOUT_PLIES, plies);
+        INSTRUMENT_COUNT(STEPS_APPLIED, plies);
+        INSTRUMENT_COUNT(TERMINAL_CHECKS, plies);
+        return plies;
+    }
+
+    // Play n games from one board, returns how many playerTag won
+    static uint32_t Wins(const Board& board, int toMove, int round, int playerTag, size_t n, uint64_t seed,
+                         uint64_t* plies = NULL, Kernel kernel = Best()) {
+        BatchGame games[LANES * 4];
+        int winners[LANES * 4];
+        uint32_t wins = 0;
+        for (size_t done = 0; done < n; ) {
+            size_t count = min(n - done, (size_t)(LANES * 4));
+            for (size_t i = 0; i < count; ++i) {
+                games[i] = BatchGame{board, toMove, round};
+            }
+            uint64_t p = Play(games, winners, count, Utils::Mix(seed, done), kernel);
+            if (plies) {
+                *plies += p;
+            }
+            for (size_t i = 0; i < count; ++i) {
+                wins += winners[i] == playerTag;
+            }
+            done += count;
+        }
+        return wins;
+    }
+private:
+#define BATCH_INLINE static inline __attribute__((always_inline))
+#define BATCH_OPERATOR(op) \
+    __attribute__((always_inline)) Lanes operator op(const Lanes& o) const { return Lanes{v op o.v}; } \
+    __attribute__((always_inline)) Lanes& operator op##=(const Lanes& o) { v op##= o.v; return *this; }
+
+    typedef uint32_t Vector __attribute__((vector_size(32)));
+
+    /*
+     A vector of the lanes. The helpers return it wrapped: a function returning a
+     bare 32 byte vector makes GCC warn about the AVX ABI (-Wpsabi) in every
+     translation unit of a baseline build, and a pragma can not scope that
+     warning since GCC reports it at the end of the unit.
+     */
+    struct Lanes {
+        Vector v;
+
+        BATCH_OPERATOR(&)
+        BATCH_OPERATOR(|)
+        BATCH_OPERATOR(^)
+        BATCH_OPERATOR(+)
+        BATCH_OPERATOR(-)
+        BATCH_OPERATOR(*)
+        BATCH_OPERATOR(<<)
+        BATCH_OPERATOR(>>)
+
+        __attribute__((always_inline)) Lanes operator~() const {
+            return Lanes{~v};
+        }
+
+        __attribute__((always_inline)) Lanes operator<<(int k) const {
+            return Lanes{v << k};
+        }
+
+        __attribute__((always_inline)) Lanes operator>>(int k) const {
+            return Lanes{v >> k};
+        }
+    };
+
+    static const uint32_t ALL = 0xffffff;
+    static const uint32_t ODD = 0xaaaaaa;
+    static const uint32_t CROSS_MIDDLES = 0xaa00;
+
+    // The state of the lanes, one vector per field
+    struct State {
+        Lanes first, second, block;
+        Lanes toMove, round, plies;
+        Lanes active;       // all ones while the lane has a game
+        Lanes rng[4];       // xoshiro128** per lane
+    };
+
+    BATCH_INLINE Lanes Splat(uint32_t x) {
+        Lanes v = {{x, x, x, x, x, x, x, x}};
+        return v;
+    }
+
+    // All ones where mask is set, b elsewhere
+    BATCH_INLINE Lanes Select(const Lanes& mask, const Lanes& a, const Lanes& b) {
+        return (a & mask) | (b & ~mask);
+    }
+
+    BATCH_INLINE Lanes Less(const Lanes& a, const Lanes& b) {
+        return Lanes{(Vector)(a.v < b.v)};
+    }
+
+    BATCH_INLINE Lanes Equal(const Lanes& a, const Lanes& b) {
+        return Lanes{(Vector)(a.v == b.v)};
+    }
+
+    BATCH_INLINE Lanes RotateClockwise(const Lanes& m) {
+        return ((m << 1) & Splat(0xfefefe)) | ((m >> 7) & Splat(0x010101));
+    }
+
+    BATCH_INLINE Lanes RotateAnticlockwise(const Lanes& m) {
+        return ((m >> 1) & Splat(0x7f7f7f)) | ((m << 7) & Splat(0x808080));
+    }
+
+    BATCH_INLINE Lanes Neighbours(const Lanes& m) {
+        Lanes odd = m & Splat(ODD);
+        return (RotateClockwise(m) | RotateAnticlockwise(m) | odd << 8 | odd >> 8) & Splat(ALL);
+    }
+
+    BATCH_INLINE Lanes FullSanPositions(const Lanes& p) {
+        Lanes ring = p & RotateClockwise(p) & RotateAnticlockwise(p) & Splat(ODD);
+        Lanes cross = p & p << 8 & p >> 8 & Splat(CROSS_MIDDLES);
+        return ring | RotateClockwise(ring) | RotateAnticlockwise(ring) | cross | cross << 8 | cross >> 8;
+    }
+
+    // Partial popcounts of m in fields of 2, 4, 8 and 16 bits
+    struct Counts {
+        Lanes c2, c4, c8, c16;
+    };
+
+    BATCH_INLINE Counts PartialCounts(const Lanes& m) {
+        Counts c;
+        c.c2 = m - ((m >> 1) & Splat(0x55555555));
+        c.c4 = (c.c2 & Splat(0x33333333)) + ((c.c2 >> 2) & Splat(0x33333333));
+        c.c8 = (c.c4 + (c.c4 >> 4)) & Splat(0x0f0f0f0f);
+        c.c16 = (c.c8 + (c.c8 >> 8)) & Splat(0x00ff00ff);
+        return c;
+    }
+
+    BATCH_INLINE Lanes Popcount(const Lanes& m) {
+        Lanes c16 = PartialCounts(m).c16;
+        return (c16 + (c16 >> 16)) & Splat(0xff);
+    }
+
+    // The bit of the r-th set position of m, r below its popcount, found by halving the window
+    BATCH_INLINE Lanes NthBit(const Lanes& m, const Lanes& index) {
+        Counts c = PartialCounts(m);
+        Lanes r = index;
+        Lanes pos = Splat(0), low, skip;
+
+        low = c.c16 & Splat(0xff);
+        skip = ~Less(r, low);
+        r -= low & skip;
+        pos += Splat(16) & skip;
+
+        low = (c.c8 >> pos) & Splat(0xff);
+        skip = ~Less(r, low);
+        r -= low & skip;
+        pos += Splat(8) & skip;
+
+        low = (c.c4 >> pos) & Splat(0xf);
+        skip = ~Less(r, low);
+        r -= low & skip;
+        pos += Splat(4) & skip;
+
+        low = (c.c2 >> pos) & Splat(0x3);
+        skip = ~Less(r, low);
+        r -= low & skip;
+        pos += Splat(2) & skip;
+
+        low = (m >> pos) & Splat(0x1);
+        skip = ~Less(r, low);
+        pos += Splat(1) & skip;
+        return (Splat(1) << pos) & m;
+    }
+
+    BATCH_INLINE Lanes Rotl(const Lanes& x, int k) {
+        return (x << k) | (x >> (32 - k));
+    }
+
+    BATCH_INLINE Lanes Next(Lanes* s) {
+        Lanes x = s[1] + (s[1] << 2);               // s[1] * 5
+        x = Rotl(x, 7);
+        Lanes result = x + (x << 3);                // * 9
+        Lanes t = s[1] << 9;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = Rotl(s[3], 11);
+        return result;
+    }
+
+    // Uniform in [0, bound) for bound below 256, from the top 24 bits (the bias is below 2^-16)
+    BATCH_INLINE Lanes Bounded(Lanes* s, const Lanes& bound) {
+        return ((Next(s) >> 8) * bound) >> 24;
+    }
+
+    // One random step in every lane, returns the lanes whose game is over; winners go to winner
+    BATCH_INLINE Lanes Ply(State& st, Lanes& winner) {
+        Lanes isFirst = Equal(st.toMove, Splat(Board::FIRST_TAG));
+        Lanes placing = Less(st.round, Splat(9));
+        Lanes self = Select(isFirst, st.first, st.second);
+        Lanes other = Select(isFirst, st.second, st.first);
+        Lanes empty = ~(st.first | st.second | st.block) & Splat(ALL);
+
+        // the steps by direction: a target of d0 is reached from its anticlockwise neighbour and so on
+        Lanes odd = self & Splat(ODD);
+        Lanes d0 = RotateClockwise(self) & empty, d1 = RotateAnticlockwise(self) & empty;
+        Lanes d2 = odd << 8 & empty, d3 = odd >> 8 & empty;
+        Lanes c0 = Popcount(d0), c1 = Popcount(d1), c2 = Popcount(d2), c3 = Popcount(d3);
+        Lanes emptyCount = Popcount(empty);
+        Lanes r = Bounded(st.rng, Select(placing, emptyCount, c0 + c1 + c2 + c3));
+
+        // walk r through the directions to the one it falls in
+        Lanes in0 = Less(r, c0), r1 = r - c0;
+        Lanes in1 = ~in0 & Less(r1, c1), r2 = r1 - c1;
+        Lanes in2 = ~in0 & ~in1 & Less(r2, c2), r3 = r2 - c2;
+        Lanes in3 = ~in0 & ~in1 & ~in2;
+        Lanes targets = (d0 & in0) | (d1 & in1) | (d2 & in2) | (d3 & in3);
+        Lanes index = (r & in0) | (r1 & in1) | (r2 & in2) | (r3 & in3);
+        targets = Select(placing, empty, targets);
+        index = Select(placing, r, index);
+        Lanes to = NthBit(targets, index);
+        Lanes from = (RotateAnticlockwise(to) & in0) | (RotateClockwise(to) & in1) | (to >> 8 & in2) | (to << 8 & in3);
+        from &= ~placing;
+
+        // a san eats a free piece of the other side, or any when all are in sans
+        Lanes moved = (self & ~from) | to;
+        Lanes san = ~Equal(FullSanPositions(moved) & to, Splat(0));
+        Lanes free = other & ~FullSanPositions(other);
+        Lanes eatable = Select(Equal(free, Splat(0)), other, free);
+        Lanes eat = NthBit(eatable, Bounded(st.rng, Popcount(eatable))) & san & st.active;
+
+        Lanes act = st.active;
+        Lanes block = Select(Equal(st.round, Splat(9)), Splat(0), st.block);
+        block |= eat & placing;
+        other &= ~eat;
+        Lanes first = Select(isFirst, moved, other), second = Select(isFirst, other, moved);
+        st.first = Select(act, first, st.first);
+        st.second = Select(act, second, st.second);
+        st.block = Select(act, block, st.block);
+
+        // Board::IsOver with the round of the step
+        empty = ~(st.first | st.second | st.block) & Splat(ALL);
+        Lanes moving = ~Less(st.round, Splat(10));
+        Lanes firstCount = Popcount(st.first), secondCount = Popcount(st.second);
+        Lanes firstLost = (moving & Less(firstCount, Splat(3))) | Equal(Neighbours(st.first) & empty, Splat(0));
+        Lanes secondLost = (moving & Less(secondCount, Splat(3))) | Equal(Neighbours(st.second) & empty, Splat(0));
+        Lanes over = ~Equal(st.round, Splat(0)) & (firstLost | secondLost);
+        winner = Select(firstLost, Splat(Board::SECOND_TAG), Splat(Board::FIRST_TAG));
+
+        st.plies += Splat(1) & act;
+        st.round += Equal(st.toMove, Splat(Board::SECOND_TAG)) & Splat(1) & act;
+        st.toMove = Select(act, Splat(Board::FIRST_TAG + Board::SECOND_TAG) - st.toMove, st.toMove);
+
+        // cut off, the one with more pieces wins
+        Lanes cut = ~over & ~Less(st.plies, Splat(MAX_PLIES));
+        Lanes ahead = Select(Less(secondCount, firstCount), Splat(Board::FIRST_TAG),
+                             Select(Less(firstCount, secondCount), Splat(Board::SECOND_TAG), Splat(0)));
+        winner = Select(cut, ahead, winner);
+        return (over | cut) & act;
+    }
+
+    // Move game into lane of st, or leave the lane idle without one
+    static void Load(State& st, int lane, const BatchGame* game) {
+        if (game) {
+            st.first.v[lane] = game->board.FindFirst().Mask();
+            st.second.v[lane] = game->board.FindSecond().Mask();
+            st.block.v[lane] = game->board.FindBlock().Mask();
+            st.toMove.v[lane] = (uint32_t)game->toMove;
+            st.round.v[lane] = (uint32_t)game->round;
+            st.plies.v[lane] = 0;
+            st.active.v[lane] = ~0u;
+        } else {
+            st.active.v[lane] = 0;
+        }
+    }
+
+    BATCH_INLINE uint64_t PlayKernel(const BatchGame* games, int* winners, size_t n, uint64_t seed) {
+        State st;
+        memset(&st, 0, sizeof(st));
+        for (int lane = 0; lane < LANES; ++lane) {
+            uint64_t x = Utils::Mix(seed, (uint64_t)lane), y = Utils::Mix(x);
+            st.rng[0].v[lane] = (uint32_t)x;
+            st.rng[1].v[lane] = (uint32_t)(x >> 32) | 1;
+            st.rng[2].v[lane] = (uint32_t)y;
+            st.rng[3].v[lane] = (uint32_t)(y >> 32);
+        }
+
+        size_t next = 0, done = 0;
+        size_t gameOf[LANES];
+        for (int lane = 0; lane < LANES; ++lane) {
+            gameOf[lane] = next;
+            Load(st, lane, next < n ? &games[next] : NULL);
+            next += next < n;
+        }
+
+        uint64_t plies = 0;
+        while (done < n) {
+            Lanes winner;
+            Lanes over = Ply(st, winner);
+            uint32_t ended[LANES], won[LANES];
+            memcpy(ended, &over, sizeof(ended));
+            uint32_t any = 0;
+            for (int lane = 0; lane < LANES; ++lane) {
+                any |= ended[lane];
+            }
+            if (!any) {
+                continue;
+            }
+            memcpy(won, &winner, sizeof(won));
+            for (int lane = 0; lane < LANES; ++lane) {
+                if (ended[lane]) {
+                    winners[gameOf[lane]] = (int)won[lane];
+                    plies += st.plies.v[lane];
+                    done++;
+                    gameOf[lane] = next;
+                    Load(st, lane, next < n ? &games[next] : NULL);
+                    next += next < n;
+                }
+            }
+        }
+        return plies;
+    }
+
+#ifdef CHENGSAN_AVX2_KERNEL
+    __attribute__((target("avx2"), noinline))
+    static uint64_t PlayAvx2(const BatchGame* games, int* winners, size_t n, uint64_t seed) {
+        return PlayKernel(games, winners, n, seed);
+    }
+#endif
+
+    __attribute__((noinline))
+    static uint64_t PlayGeneric(const BatchGame* games, int* winners, size_t n, uint64_t seed) {
+        return PlayKernel(games, winners, n, seed);
+    }
+
+#undef BATCH_OPERATOR
+#undef BATCH_INLINE
+};
+
+#endif /* batchplayout_h */
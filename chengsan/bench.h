@@ -0,0 +1,362 @@
+//
+//  bench.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef bench_h
+#define bench_h
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "board.h"
+#include "alphabeta.h"
+#include "batchplayout.h"
+#include "player.h"
+#include "ntuple.h"
+#include "rng.h"
+
+using namespace std;
+
+// A board to benchmark on, with the player to move and the round
+struct BenchPosition {
+    Board board;
+    int toMove;
+    int round;
+};
+
+// Timing of one benchmark, in nanoseconds per operation over the samples
+struct BenchResult {
+    string name;
+    double median;
+    double mean;
+    double stddev;
+};
+
+/*
+ Benchmarks of the board primitives and the engines. Positions come from
+ random games with a fixed seed, so every run measures the same work. A
+ benchmark is timed in SAMPLES samples of about SAMPLE_MILLIS each, and the
+ median is what gets reported, saved and compared.
+ */
+class Bench {
+public:
+    static const int SAMPLES = 9;
+    static const int SAMPLE_MILLIS = 20;
+    static const size_t CORPUS_SIZE = 1024;
+    static const uint64_t SEED = 20161017;
+    static const size_t BATCH_PLAYOUTS = 16;
+    static const size_t SCALING_POSITIONS = 8;
+
+    Bench() {
+        MakeCorpus();
+    }
+
+    const vector<BenchPosition>& Placing() const {
+        return placing;
+    }
+
+    const vector<BenchPosition>& Moving() const {
+        return moving;
+    }
+
+    vector<BenchResult> RunAll(FILE* log = stdout) {
+        vector<BenchResult> results;
+        auto add = [&](const BenchResult& result) {
+            results.push_back(result);
+            if (log) {
+                fprintf(log, "%-34s %12.1f ns/op  (mean %.1f, +-%.1f%%)\n", result.name.c_str(), result.median,
+                        result.mean, result.mean > 0 ? 100 * result.stddev / result.mean : 0);
+                fflush(log);
+            }
+        };
+
+        for (int phase = 0; phase < 2; ++phase) {
+            const vector<BenchPosition>& corpus = phase == 0 ? placing : moving;
+            string suffix = phase == 0 ? " placing" : " moving";
+
+            add(Measure("FindPossibleSteps" + suffix, corpus, [](BenchPosition& p) {
+                MoveList steps;
+                p.board.FindPossibleSteps(p.toMove, p.round, steps);
+                return (uint64_t)steps.size();
+            }));
+            add(Measure("FindToEat" + suffix, corpus, [](BenchPosition& p) {
+                return (uint64_t)p.board.FindToEat(Board::Opponent(p.toMove)).Mask();
+            }));
+            add(Measure("CanMakeSan" + suffix, corpus, [](BenchPosition& p) {
+                uint64_t count = 0;
+                for (size_t pos: p.board.FindEmpty()) {
+                    count += p.board.CanMakeSan(p.toMove, pos);
+                }
+                return count;
+            }));
+            add(Measure("IsOver" + suffix, corpus, [](BenchPosition& p) {
+                int winner = 0;
+                return (uint64_t)p.board.IsOver(winner, p.round) + winner;
+            }));
+            add(Measure("DoStep+UndoStep" + suffix, corpus, [](BenchPosition& p) {
+                MoveList steps;
+                p.board.FindPossibleSteps(p.toMove, p.round, steps);
+                uint64_t key = 0;
+                for (auto& step: steps) {
+                    StepUndo undo = p.board.DoStep(step, p.round);
+                    key ^= p.board.Key();
+                    p.board.UndoStep(undo);
+                }
+                return key;
+            }, true));
+        }
+        add(Measure("FindMoveSteps", moving, [](BenchPosition& p) {
+            MoveList steps;
+            p.board.FindMoveSteps(p.toMove, steps);
+            return (uint64_t)steps.size();
+        }));
+        add(Measure("Board copy", moving, [](BenchPosition& p) {
+            Board copy = p.board;
+            Escape(copy);
+            return copy.Key() ^ copy.FindFirst().Mask() ^ (uint64_t)copy.FindSecond().Mask() << 24
+                ^ (uint64_t)copy.FindEmpty().Mask() << 48;
+        }));
+        // the weights do not change the cost, the trained ones are used when there are any
+        NTupleNetwork zeros;
+        const NTupleNetwork& network = NTupleNetwork::Shared() ? *NTupleNetwork::Shared() : zeros;
+        for (int phase = 0; phase < 2; ++phase) {
+            add(Measure(string("N-tuple evaluation") + (phase == 0 ? " placing" : " moving"), phase == 0 ? placing : moving,
+                        [&](BenchPosition& p) {
+                return (uint64_t)(network.Evaluate(p.board, p.toMove, p.round) * 1e6f);
+            }));
+        }
+
+        Player first(Board::FIRST_TAG, Board::SECOND_TAG, SEED), second(Board::SECOND_TAG, Board::FIRST_TAG, SEED);
+        Rng rng(SEED);
+        add(Measure("Random playout", placing, [&](BenchPosition& p) {
+            // Playout is run by the player who just moved, the other one is to move
+            const Player& self = p.toMove == Board::FIRST_TAG ? second : first;
+            const Player& other = p.toMove == Board::FIRST_TAG ? first : second;
+            return (uint64_t)self.Playout(p.board, p.round, other, p.toMove == Board::SECOND_TAG, rng);
+        }, true));
+        // per playout, so they compare with the scalar one above
+        uint64_t batchSeed = SEED;
+        for (int k = BatchPlayout::GENERIC; k <= BatchPlayout::AVX2; ++k) {
+            BatchPlayout::Kernel kernel = (BatchPlayout::Kernel)k;
+            if (kernel == BatchPlayout::AVX2 && !BatchPlayout::HasAvx2()) {
+                continue;
+            }
+            add(Measure(string("Batch playout ") + BatchPlayout::KernelName(kernel), placing, [&](BenchPosition& p) {
+                return (uint64_t)BatchPlayout::Wins(p.board, p.toMove, p.round, Board::FIRST_TAG, BATCH_PLAYOUTS,
+                                                    batchSeed++, NULL, kernel);
+            }, true, BATCH_PLAYOUTS));
+        }
+        add(TimeToMove("MonteCarlo 2000 playouts placing", placing[placing.size() / 2], first, second));
+        add(TimeToMove("MonteCarlo 2000 playouts moving", moving[moving.size() / 2], first, second));
+        return results;
+    }
+
+    /*
+     Lazy SMP time to depth: SCALING_POSITIONS positions of both phases searched
+     to depth with every thread count, each by a new player so that no run
+     starts from a table the one before filled. Speedups are against the first
+     thread count.
+     */
+    void Scaling(int depth, const vector<size_t>& threadCounts, FILE* log = stdout) const {
+        fprintf(log, "%8s %12s %8s %14s %14s %22s\n", "threads", "ms", "speedup", "nodes", "nodes/s",
+                "nodes per thread");
+        double baseline = 0;
+        for (size_t threads: threadCounts) {
+            double seconds = 0;
+            uint64_t nodes = 0;
+            vector<uint64_t> threadNodes(threads, 0);
+            for (size_t i = 0; i < SCALING_POSITIONS; ++i) {
+                const vector<BenchPosition>& corpus = i % 2 ? moving : placing;
+                const BenchPosition& p = corpus[i * corpus.size() / SCALING_POSITIONS];
+                AlphaBetaPlayer player(p.toMove, Board::Opponent(p.toMove), 16, threads);
+                SearchInfo info;
+                auto start = chrono::steady_clock::now();
+                player.Search(p.board, p.round, SearchLimits::Depth(depth), &info);
+                seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                nodes += info.nodes;
+                vector<uint64_t> searched = player.ThreadNodes();
+                for (size_t t = 0; t < threads; ++t) {
+                    threadNodes[t] += searched[t];
+                }
+            }
+            uint64_t least = *min_element(threadNodes.begin(), threadNodes.end());
+            uint64_t most = *max_element(threadNodes.begin(), threadNodes.end());
+            if (baseline == 0) {
+                baseline = seconds;
+            }
+            fprintf(log, "%8zu %12.1f %7.2fx %14llu %14.0f %10llu - %-10llu\n", threads, seconds * 1e3,
+                    baseline / seconds, (unsigned long long)nodes, nodes / seconds, (unsigned long long)least,
+                    (unsigned long long)most);
+            fflush(log);
+        }
+    }
+
+    static bool Save(const vector<BenchResult>& results, const char* path) {
+        FILE* file = fopen(path, "w");
+        if (!file) {
+            return false;
+        }
+        fprintf(file, "{\n");
+        for (size_t i = 0; i < results.size(); ++i) {
+            fprintf(file, "  \"%s\": {\"median\": %.3f, \"stddev\": %.3f}%s\n", results[i].name.c_str(),
+                    results[i].median, results[i].stddev, i + 1 < results.size() ? "," : "");
+        }
+        fprintf(file, "}\n");
+        return fclose(file) == 0;
+    }
+
+    // Medians of a file written by Save, by benchmark name
+    static bool Load(const char* path, map<string, double>& medians) {
+        FILE* file = fopen(path, "r");
+        if (!file) {
+            return false;
+        }
+        char line[512], name[256];
+        double median;
+        while (fgets(line, sizeof(line), file)) {
+            if (sscanf(line, " \"%255[^\"]\": {\"median\": %lf", name, &median) == 2) {
+                medians[name] = median;
+            }
+        }
+        fclose(file);
+        return true;
+    }
+
+    /*
+     Print every benchmark against its baseline median. A benchmark regressed
+     when it is slower by more than tolerance and by more than 2 of its own
+     standard deviations. Returns the number of regressions.
+     */
+    static int Compare(const vector<BenchResult>& results, const map<string, double>& baseline,
+                       double tolerance = 0.05, FILE* log = stdout) {
+        int regressions = 0;
+        for (auto& result: results) {
+            auto found = baseline.find(result.name);
+            if (found == baseline.end() || found->second <= 0) {
+                fprintf(log, "%-34s no baseline\n", result.name.c_str());
+                continue;
+            }
+            double change = result.median / found->second - 1;
+            bool regressed = change > tolerance && result.median - found->second > 2 * result.stddev;
+            regressions += regressed;
+            fprintf(log, "%-34s %12.1f -> %12.1f ns/op  %+6.1f%%%s\n", result.name.c_str(), found->second,
+                    result.median, 100 * change, regressed ? "  REGRESSION" : "");
+        }
+        return regressions;
+    }
+private:
+    // Random games from the start, keeping a position of every game in each phase
+    void MakeCorpus() {
+        Player first(Board::FIRST_TAG, Board::SECOND_TAG, SEED), second(Board::SECOND_TAG, Board::FIRST_TAG, SEED);
+        Rng rng(SEED);
+        while (placing.size() < CORPUS_SIZE || moving.size() < CORPUS_SIZE) {
+            Board board;
+            int round = 0, toMove = Board::FIRST_TAG, winner;
+            int placeAt = (int)rng.Bounded(18), moveAt = 20 + (int)rng.Bounded(40);
+            for (int ply = 0; ply < 200; ++ply) {
+                if (ply == placeAt && placing.size() < CORPUS_SIZE) {
+                    placing.push_back(BenchPosition{board, toMove, round});
+                }
+                if (ply == moveAt && moving.size() < CORPUS_SIZE) {
+                    moving.push_back(BenchPosition{board, toMove, round});
+                }
+                const Player& player = toMove == Board::FIRST_TAG ? first : second;
+                board.ApplyStep(player.Random(board, round, rng), round);
+                if (board.IsOver(winner, round)) {
+                    break;
+                }
+                round = Board::NextRound(toMove, round);
+                toMove = Board::Opponent(toMove);
+            }
+        }
+    }
+
+    /*
+     Time op over the corpus. The op gets a copy of each position, unless
+     inPlace, where it must leave the position as it found it. Results are
+     summed into a sink so that the work can not be optimized away. An op doing
+     work operations per call is timed per operation.
+     */
+    BenchResult Measure(const string& name, const vector<BenchPosition>& corpus,
+                        const function<uint64_t(BenchPosition&)>& op, bool inPlace = false, size_t work = 1) {
+        vector<BenchPosition> positions = corpus;
+        // calibrate the rounds over the corpus for a sample to take SAMPLE_MILLIS
+        size_t rounds = 1;
+        while (true) {
+            double nanos = RunRounds(positions, op, rounds, inPlace);
+            if (nanos >= SAMPLE_MILLIS * 1e6 / 4 || rounds >= (1u << 20)) {
+                rounds = max<size_t>(1, (size_t)(rounds * SAMPLE_MILLIS * 1e6 / max(nanos, 1.0)));
+                break;
+            }
+            rounds *= 4;
+        }
+
+        vector<double> samples;
+        for (int i = 0; i < SAMPLES; ++i) {
+            samples.push_back(RunRounds(positions, op, rounds, inPlace) / (rounds * positions.size() * work));
+        }
+        return Summarize(name, samples);
+    }
+
+    double RunRounds(vector<BenchPosition>& positions, const function<uint64_t(BenchPosition&)>& op, size_t rounds,
+                     bool inPlace) {
+        auto start = chrono::steady_clock::now();
+        for (size_t r = 0; r < rounds; ++r) {
+            for (auto& position: positions) {
+                if (inPlace) {
+                    sink += op(position);
+                } else {
+                    BenchPosition copy = position;
+                    sink += op(copy);
+                }
+            }
+        }
+        return (double)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    }
+
+    BenchResult TimeToMove(const string& name, const BenchPosition& position, const Player& first, const Player& second) {
+        const Player& self = position.toMove == Board::FIRST_TAG ? first : second;
+        const Player& other = position.toMove == Board::FIRST_TAG ? second : first;
+        vector<double> samples;
+        for (int i = 0; i < SAMPLES; ++i) {
+            auto start = chrono::steady_clock::now();
+            Step step = self.MonteCarlo(position.board, position.round, other, position.toMove == Board::FIRST_TAG,
+                                        SearchLimits::Playouts(2000));
+            samples.push_back((double)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+            sink += step.Encode();
+        }
+        return Summarize(name, samples);
+    }
+
+    // The compiler has to write value to memory here and read it back after, so a copy is not folded away
+    template <typename T>
+    static void Escape(const T& value) {
+        asm volatile("" : : "r"(&value) : "memory");
+    }
+
+    static BenchResult Summarize(const string& name, vector<double> samples) {
+        sort(samples.begin(), samples.end());
+        double mean = 0, variance = 0;
+        for (double sample: samples) {
+            mean += sample / samples.size();
+        }
+        for (double sample: samples) {
+            variance += (sample - mean) * (sample - mean) / samples.size();
+        }
+        return BenchResult{name, samples[samples.size() / 2], mean, sqrt(variance)};
+    }
+
+    vector<BenchPosition> placing, moving;
+    volatile uint64_t sink = 0;
+};
+
+#endif /* bench_h */
@@ -10,11 +10,14 @@
 #define board_h
 
 #include <array>
+#include <string>
 #include <vector>
-#include <unordered_map>
-#include <unordered_set>
 #include <algorithm>
+#include <type_traits>
+#include <cassert>
+#include "posset.h"
 #include "step.h"
+#include "movelist.h"
 
 using namespace std;
 
@@ -35,39 +38,215 @@ using namespace std;
  |            |           |
  6------------5-----------4
  */
+
+/*
+ Lookup tables of the board, built at compile time. Every line (san) is listed
+ once in SANS, the neighbours and the lines through each position are derived
+ from it: two positions are neighbours iff they are next to each other on a line.
+ */
+struct BoardTables {
+    static constexpr size_t SAN_NUMBER = 16;
+    static constexpr size_t SANS[SAN_NUMBER][3] = {
+        {0, 1, 2},
+        {2, 3, 4},
+        {4, 5, 6},
+        {6, 7, 0},
+        {8, 9, 10},
+        {10, 11, 12},
+        {12, 13, 14},
+        {14, 15, 8},
+        {16, 17, 18},
+        {18, 19, 20},
+        {20, 21, 22},
+        {22, 23, 16},
+        {1, 9, 17},
+        {3, 11, 19},
+        {5, 13, 21},
+        {7, 15, 23}
+    };
+
+    uint32_t sans[SAN_NUMBER];  // mask of each line
+    uint32_t nexts[24];         // mask of the neighbours of each position
+    uint32_t luPosSan[24][2];   // masks of the 2 lines through each position
+
+    static constexpr BoardTables Make() {
+        BoardTables t = {};
+        for (size_t i = 0; i < SAN_NUMBER; ++i) {
+            uint32_t san = 0;
+            for (size_t j = 0; j < 3; ++j) {
+                san |= 1u << SANS[i][j];
+            }
+            t.sans[i] = san;
+
+            for (size_t j = 0; j < 2; ++j) {
+                t.nexts[SANS[i][j]] |= 1u << SANS[i][j + 1];
+                t.nexts[SANS[i][j + 1]] |= 1u << SANS[i][j];
+            }
+
+            for (size_t j = 0; j < 3; ++j) {
+                size_t pos = SANS[i][j];
+                t.luPosSan[pos][t.luPosSan[pos][0] ? 1 : 0] = san;
+            }
+        }
+        return t;
+    }
+};
+
+/*
+ What Board::DoStep needs to remember so that Board::UndoStep can restore the
+ exact previous state: the step itself, the blocks cleared at round 9 and the
+ previous tags of the (at most 3) positions the step touched.
+ */
+struct StepUndo {
+    StepUndo(const Step& step = Step::MakePlaceStep(0, Step::NONE_POS))
+    :step(step), clearedBlocks(0), fromTag(0), toTag(0), eatTag(0) {
+    }
+
+    Step step;
+    uint32_t clearedBlocks;
+    int8_t fromTag, toTag, eatTag;  // fromTag is the placePos tag for PLACE steps
+};
+
+/*
+ Random keys for Zobrist hashing, generated at compile time with splitmix64.
+ A board key is the XOR of pieces[pos][tag] over every non empty position.
+ The round keys tell the placement rounds apart and mark round 9, where the
+ blocks are cleared, and the moving phase (every round after 9) as one phase.
+ */
+struct ZobristTables {
+    static constexpr int ROUND_PHASES = 11;
+
+    uint64_t pieces[24][4];
+    uint64_t rounds[ROUND_PHASES];
+    uint64_t secondToMove;
+
+    static constexpr uint64_t Next(uint64_t& state) {
+        state += 0x9e3779b97f4a7c15ull;
+        uint64_t z = state;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    static constexpr ZobristTables Make() {
+        ZobristTables t = {};
+        uint64_t state = 0x6368656e6773616eull;
+        for (size_t pos = 0; pos < 24; ++pos) {
+            for (size_t tag = 1; tag < 4; ++tag) {
+                t.pieces[pos][tag] = Next(state);
+            }
+        }
+        for (int i = 0; i < ROUND_PHASES; ++i) {
+            t.rounds[i] = Next(state);
+        }
+        t.secondToMove = Next(state);
+        return t;
+    }
+};
+
 class Board {
 public:
-    static const unordered_map<size_t, vector<size_t>> nexts;
-    static const array<array<size_t, 3>, 16> sans;
+    static constexpr BoardTables tables = BoardTables::Make();
+    static constexpr ZobristTables zobrist = ZobristTables::Make();
 
-    static const unordered_map<size_t, array<array<size_t, 3>, 2>> luPosSan;
-    
     static const int EMPTY_TAG = 0,     // Mark the empty positions
                      FIRST_TAG = 1,     // Mark the 1st player's pieces' positions
                      SECOND_TAG = 2,    // Mark the 2nd player's pieces' positions
                      BLOCK_TAG = 3;     // Mark the blocked positions
 
+    static Board FromMasks(uint32_t first, uint32_t second, uint32_t block = 0) {
+        Board board;
+        for (size_t pos: PosSet(first)) {
+            board.SetFirst(pos);
+        }
+        for (size_t pos: PosSet(second)) {
+            board.SetSecond(pos);
+        }
+        for (size_t pos: PosSet(block)) {
+            board.SetBlock(pos);
+        }
+        return board;
+    }
+
+    // Parse 24 characters, one per position: '.' empty, '1' first, '2' second, '*' block
+    static bool FromString(const string& text, Board& board) {
+        if (text.size() != 24) {
+            return false;
+        }
+        Board res;
+        for (size_t pos = 0; pos < 24; ++pos) {
+            size_t tag = string(".12*").find(text[pos]);
+            if (tag == string::npos) {
+                return false;
+            }
+            res.Set(pos, (int)tag);
+        }
+        board = res;
+        return true;
+    }
+
+    string ToString() const {
+        string text(24, '.');
+        for (size_t pos = 0; pos < 24; ++pos) {
+            text[pos] = ".12*"[At(pos)];
+        }
+        return text;
+    }
+
+    static int Opponent(int playerTag) {
+        return playerTag == FIRST_TAG ? SECOND_TAG : FIRST_TAG;
+    }
+
+    // The round of the next step, after playerTag made a step in round
+    static int NextRound(int playerTag, int round) {
+        return playerTag == SECOND_TAG ? round + 1 : round;
+    }
+
     Board()
-    : board({EMPTY_TAG}), emptyPos({0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23}) {
+    :firstMask(0), secondMask(0), blockMask(0), key(0) {
+    }
+
+    // Zobrist key of the positions alone, kept up to date by every change
+    uint64_t Key() const {
+        return key;
+    }
+
+    // Key() computed from scratch
+    uint64_t ComputeKey() const {
+        uint64_t res = 0;
+        for (size_t pos = 0; pos < 24; ++pos) {
+            res ^= zobrist.pieces[pos][At(pos)];
+        }
+        return res;
+    }
+
+    // Zobrist key of the whole game state: positions, round phase and the player to move
+    uint64_t Hash(int playerToMove, int round) const {
+        int phase = round < ZobristTables::ROUND_PHASES - 1 ? round : ZobristTables::ROUND_PHASES - 1;
+        return key ^ zobrist.rounds[phase] ^ (playerToMove == SECOND_TAG ? zobrist.secondToMove : 0);
     }
 
-    const unordered_set<size_t>& FindEmpty() const {
-        return emptyPos;
+    PosSet FindEmpty() const {
+        return PosSet(~(firstMask | secondMask | blockMask) & PosSet::ALL);
     }
 
-    const unordered_set<size_t>& FindFirst() const {
-        return firstPos;
+    PosSet FindFirst() const {
+        return PosSet(firstMask);
     }
 
-    const unordered_set<size_t>& FindSecond() const {
-        return secondPos;
+    PosSet FindSecond() const {
+        return PosSet(secondMask);
     }
     
-    const unordered_set<size_t>& FindPlayer(int playerTag) const {
+    PosSet FindBlock() const {
+        return PosSet(blockMask);
+    }
+
+    PosSet FindPlayer(int playerTag) const {
         return playerTag == 1 ? FindFirst() : FindSecond();
     }
     
-    int PieceNumber(int playerTag) {
+    int PieceNumber(int playerTag) const {
         switch (playerTag) {
             case FIRST_TAG:
                 return FirstPieceNumber();
@@ -80,89 +259,115 @@ public:
     }
     
     int FirstPieceNumber() const {
-        return (int)firstPos.size();
+        return __builtin_popcount(firstMask);
     }
     
     int SecondPieceNumber() const {
-        return (int)secondPos.size();
+        return __builtin_popcount(secondMask);
     }
 
-    vector<Step> FindMoveSteps(int playerTag) const {
-        vector<Step> res;
+    void FindMoveSteps(int playerTag, MoveList& steps) const {
+        steps.clear();
+        uint32_t empty = FindEmpty().Mask();
         for (size_t from: FindPlayer(playerTag)) {
-            for (auto to: nexts.at(from)) {
-                if (!EmptyAt(to)) {
-                    continue;
-                }
-                res.push_back(Step::MakeMoveStep(playerTag, from, to));
+            for (auto to: PosSet(tables.nexts[from] & empty)) {
+                steps.push_back(Step::MakeMoveStep(playerTag, from, to));
             }
         }
-        return res;
     }
     
+    /*
+     The counts below work on whole masks at once instead of walking pieces and
+     lines. Every ring is a byte numbered clockwise, so the ring neighbours of a
+     set are its bytes rotated by one, and the cross neighbours of the odd
+     positions are 8 bits away. Every line has an odd position in its middle:
+     a ring line is (m - 1, m, m + 1), a cross line is (m - 8, m, m + 8) with m
+     in the middle ring. Each result costs a few shifts and popcounts, and
+     nothing has to be kept up to date when pieces move.
+     */
+    int CountMoveSteps(int playerTag) const {
+        uint32_t pieces = FindPlayer(playerTag).Mask(), empty = FindEmpty().Mask(), odd = pieces & ODD;
+        // one popcount per direction, a target can be reached from both sides
+        return __builtin_popcount(RotateClockwise(pieces) & empty) + __builtin_popcount(RotateAnticlockwise(pieces) & empty)
+            + __builtin_popcount(odd << 8 & empty) + __builtin_popcount(odd >> 8 & empty);
+    }
+
+    // Lines with 2 pieces of playerTag and an empty position, a san in one step when placing
+    int CountOpenSans(int playerTag) const {
+        uint32_t pieces = FindPlayer(playerTag).Mask(), empty = FindEmpty().Mask();
+        uint32_t ring = OpenMiddles(pieces, RotateAnticlockwise(pieces), RotateClockwise(pieces),
+                                    empty, RotateAnticlockwise(empty), RotateClockwise(empty)) & ODD;
+        uint32_t cross = OpenMiddles(pieces, pieces << 8, pieces >> 8, empty, empty << 8, empty >> 8) & CROSS_MIDDLES;
+        // cross middles are moved above bit 24, out of the way of the ring ones
+        return __builtin_popcount(ring | cross << 16);
+    }
+
     bool HasMovableSteps(int playerTag) const {
-        for (size_t from: FindPlayer(playerTag)) {
-            for (auto to: nexts.at(from)) {
-                if (EmptyAt(to)) {
-                    return true;
-                }
-            }
-        }
-        return false;
+        return (Neighbours(FindPlayer(playerTag).Mask()) & FindEmpty().Mask()) != 0;
+    }
+
+    // Pieces of either player in a san of their own, they are only eaten when nothing else can be
+    PosSet FindProtected() const {
+        return PosSet(FullSanPositions(firstMask) | FullSanPositions(secondMask));
+    }
+
+    static uint32_t Neighbours(uint32_t mask) {
+        uint32_t odd = mask & ODD;
+        return (RotateClockwise(mask) | RotateAnticlockwise(mask) | odd << 8 | odd >> 8) & PosSet::ALL;
     }
     
     int At(size_t pos) const {
-        return board[pos];
+        uint32_t bit = PosSet::Bit(pos);
+        if (firstMask & bit) {
+            return FIRST_TAG;
+        } else if (secondMask & bit) {
+            return SECOND_TAG;
+        } else if (blockMask & bit) {
+            return BLOCK_TAG;
+        }
+        return EMPTY_TAG;
     }
     
     bool EmptyAt(size_t pos) const {
-        return board[pos] == EMPTY_TAG;
+        return !((firstMask | secondMask | blockMask) & PosSet::Bit(pos));
     }
     
     void SetEmpty(size_t pos) {
-        if (FirstAt(pos)) {
-            firstPos.erase(pos);
-        } else if (SecondAt(pos)) {
-            secondPos.erase(pos);
-        } else if (BlockedAt(pos)) {
-            blockPos.erase(pos);
-        }
-        board[pos] = EMPTY_TAG;
-        emptyPos.insert(pos);
+        key ^= zobrist.pieces[pos][At(pos)];
+        uint32_t clear = ~PosSet::Bit(pos);
+        firstMask &= clear;
+        secondMask &= clear;
+        blockMask &= clear;
     }
 
     bool FirstAt(size_t pos) const {
-        return board[pos] == FIRST_TAG;
+        return (firstMask >> pos) & 1;
     }
     
     void SetFirst(size_t pos) {
-        board[pos] = FIRST_TAG;
-        firstPos.insert(pos);
-        emptyPos.erase(pos);
+        SetEmpty(pos);
+        firstMask |= PosSet::Bit(pos);
+        key ^= zobrist.pieces[pos][FIRST_TAG];
     }
 
     bool SecondAt(size_t pos) const {
-        return board[pos] == SECOND_TAG;
+        return (secondMask >> pos) & 1;
     }
     
     void SetSecond(size_t pos) {
-        board[pos] = SECOND_TAG;
-        secondPos.insert(pos);
-        emptyPos.erase(pos);
+        SetEmpty(pos);
+        secondMask |= PosSet::Bit(pos);
+        key ^= zobrist.pieces[pos][SECOND_TAG];
     }
 
     bool BlockedAt(size_t pos) const {
-        return board[pos] == BLOCK_TAG;
+        return (blockMask >> pos) & 1;
     }
     
     void SetBlock(size_t pos) {
-        if (FirstAt(pos)) {
-            firstPos.erase(pos);
-        } else if (SecondAt(pos)) {
-            secondPos.erase(pos);
-        }
-        board[pos] = BLOCK_TAG;
-        blockPos.insert(pos);
+        SetEmpty(pos);
+        blockMask |= PosSet::Bit(pos);
+        key ^= zobrist.pieces[pos][BLOCK_TAG];
     }
     
     void ClearBlock(size_t pos) {
@@ -170,11 +375,10 @@ public:
     }
     
     void ClearBlocks() {
-        for (size_t i = 0; i < 24; ++i) {
-            if (board[i] == BLOCK_TAG) {
-                ClearBlock(i);
-            }
+        for (size_t pos: PosSet(blockMask)) {
+            key ^= zobrist.pieces[pos][BLOCK_TAG];
         }
+        blockMask = 0;
     }
     
     void Move(size_t from, size_t to) {
@@ -190,56 +394,93 @@ public:
         SetEmpty(from);
     }
 
-    unordered_set<size_t> FindFreePiece(int playerTag) const {
-        unordered_set<size_t> res;
-        auto positions = FindPlayer(playerTag);
-        for_each(positions.begin(), positions.end(), [&](size_t pos) {
-            if (IsFreePiece(playerTag, pos)) {
-                res.insert(pos);
-            }
-        });
-        return res;
+    PosSet FindFreePiece(int playerTag) const {
+        uint32_t pieces = FindPlayer(playerTag).Mask();
+        return PosSet(pieces & ~FullSanPositions(pieces));
     }
 
     bool IsFreePiece(int player, size_t pos) const {
-        auto& allSan = luPosSan.at(pos);
-        return all_of(allSan.begin(), allSan.end(), [&](const array<size_t, 3>& san) {
-            return any_of(san.begin(), san.end(), [&](size_t pos) {
-                return board[pos] != player;
-            });
-        });
-    }
-
-    unordered_set<size_t> FindToEat(int player) const {
-        auto res = FindFreePiece(player);
-        if (res.empty()) {
-            return FindPlayer(player);
-        }
-        return res;
+        uint32_t pieces = FindPlayer(player).Mask();
+        auto& allSan = tables.luPosSan[pos];
+        return (pieces & allSan[0]) != allSan[0] && (pieces & allSan[1]) != allSan[1];
+    }
+
+    PosSet FindToEat(int player) const {
+        uint32_t pieces = FindPlayer(player).Mask(), free = pieces & ~FullSanPositions(pieces);
+        return PosSet(free ? free : pieces);
     }
 
     bool CanMakeSan(int player, size_t pos, size_t from = Step::NONE_POS) const {
-        for (auto san: luPosSan.at(pos)) {
-            if (all_of(san.begin(), san.end(), [=](size_t curPos) {
-                if (from != Step::NONE_POS && curPos == from) {
-                    return false;
+        uint32_t pieces = FindPlayer(player).Mask();
+        if (from != Step::NONE_POS) {
+            pieces &= ~PosSet::Bit(from);
+        }
+        pieces |= PosSet::Bit(pos);
+
+        auto& allSan = tables.luPosSan[pos];
+        return (pieces & allSan[0]) == allSan[0] || (pieces & allSan[1]) == allSan[1];
+    }
+
+    // Every step playerTag can make in round, one per piece it can eat when the step makes a san
+    void FindPossibleSteps(int playerTag, int round, MoveList& steps) const {
+        steps.clear();
+        uint32_t toEat = FindToEat(Opponent(playerTag)).Mask();
+        if (round < 9) {
+            for (auto pos: FindEmpty()) {
+                AddSteps(steps, Step::MakePlaceStep(playerTag, pos), CanMakeSan(playerTag, pos) ? toEat : 0);
+            }
+        } else {
+            uint32_t empty = FindEmpty().Mask();
+            for (size_t from: FindPlayer(playerTag)) {
+                for (auto to: PosSet(tables.nexts[from] & empty)) {
+                    AddSteps(steps, Step::MakeMoveStep(playerTag, from, to), CanMakeSan(playerTag, to, from) ? toEat : 0);
                 }
-                return curPos == pos || board[curPos] == player;
-            })) {
-                return true;
             }
         }
+    }
 
-        return false;
+    // FindPossibleSteps into a new vector, for code off the search paths
+    vector<Step> FindPossibleSteps(int playerTag, int round) const {
+        MoveList steps;
+        FindPossibleSteps(playerTag, round, steps);
+        return vector<Step>(steps.begin(), steps.end());
+    }
+
+    void Set(size_t pos, int tag) {
+        switch (tag) {
+            case FIRST_TAG:
+                SetFirst(pos);
+                break;
+            case SECOND_TAG:
+                SetSecond(pos);
+                break;
+            case BLOCK_TAG:
+                SetBlock(pos);
+                break;
+            default:
+                SetEmpty(pos);
+                break;
+        }
     }
 
     void ApplyStep(const Step& step, int round) {
+        DoStep(step, round);
+    }
+
+    StepUndo DoStep(const Step& step, int round) {
+#ifdef DEBUG
+        Board before = *this;
+#endif
+        StepUndo undo(step);
+
         if (round == 9) {
+            undo.clearedBlocks = blockMask;
             ClearBlocks();
         }
         
         switch (step.type) {
             case Step::PLACE:
+                undo.fromTag = At(step.placePos);
                 if (step.playerTag == FIRST_TAG) {
                     SetFirst(step.placePos);
                 } else if (step.playerTag == SECOND_TAG) {
@@ -247,17 +488,60 @@ public:
                 }
                 
                 if (step.eatPos != Step::NONE_POS) {
+                    undo.eatTag = At(step.eatPos);
                     SetBlock(step.eatPos);
                 }
                 break;
             case Step::MOVE:
+                undo.fromTag = At(step.moveFrom);
+                undo.toTag = At(step.moveTo);
                 Move(step.moveFrom, step.moveTo);
                 if (step.eatPos != Step::NONE_POS) {
+                    undo.eatTag = At(step.eatPos);
                     SetEmpty(step.eatPos);
                 }
             default:
                 break;
         }
+
+#ifdef DEBUG
+        Board check = *this;
+        check.UndoStep(undo);
+        assert(check == before && "UndoStep must restore the board DoStep started from");
+        assert(key == ComputeKey() && "the Zobrist key must follow every change");
+#endif
+        return undo;
+    }
+
+    void UndoStep(const StepUndo& undo) {
+        const Step& step = undo.step;
+        if (step.eatPos != Step::NONE_POS) {
+            Set(step.eatPos, undo.eatTag);
+        }
+
+        switch (step.type) {
+            case Step::PLACE:
+                Set(step.placePos, undo.fromTag);
+                break;
+            case Step::MOVE:
+                Set(step.moveTo, undo.toTag);
+                Set(step.moveFrom, undo.fromTag);
+            default:
+                break;
+        }
+
+        for (size_t pos: PosSet(undo.clearedBlocks)) {
+            SetBlock(pos);
+        }
+    }
+
+    bool operator==(const Board& other) const {
+        return firstMask == other.firstMask && secondMask == other.secondMask && blockMask == other.blockMask
+            && key == other.key;
+    }
+
+    bool operator!=(const Board& other) const {
+        return !(*this == other);
     }
 
     bool IsOver(int& winner, int round) const {
@@ -266,12 +550,12 @@ public:
             return false;
         }
         
-        if ((round > 9 && FindFirst().size() <= 2) || !HasMovableSteps(FIRST_TAG)) {
+        if ((round > 9 && FirstPieceNumber() <= 2) || !HasMovableSteps(FIRST_TAG)) {
             winner = SECOND_TAG;
             return true;
         }
 
-        if ((round > 9 && FindSecond().size() <= 2) || !HasMovableSteps(SECOND_TAG)) {
+        if ((round > 9 && SecondPieceNumber() <= 2) || !HasMovableSteps(SECOND_TAG)) {
             winner = FIRST_TAG;
             return true;
         }
@@ -279,81 +563,57 @@ public:
         return false;
     }
 private:
-    array<int, 24> board;
-    unordered_set<size_t> emptyPos, firstPos, secondPos, blockPos;
-};
+    // step itself, or one copy per piece in toEat
+    static void AddSteps(MoveList& steps, Step step, uint32_t toEat) {
+        if (!toEat) {
+            steps.push_back(step);
+            return;
+        }
+        for (size_t eatPos: PosSet(toEat)) {
+            step.eatPos = (uint32_t)eatPos;
+            steps.push_back(step);
+        }
+    }
 
-const unordered_map<size_t, vector<size_t>> Board::nexts = {
-    {0, {1, 7}},
-    {1, {0, 2, 9}},
-    {2, {1, 3}},
-    {3, {2, 4, 11}},
-    {4, {3, 5}},
-    {5, {4, 6, 13}},
-    {6, {5, 7}},
-    {7, {0, 6, 15}},
-    {8, {9, 15}},
-    {9, {1, 8, 10, 17}},
-    {10, {9, 11}},
-    {11, {3, 10, 12, 19}},
-    {12, {11, 13}},
-    {13, {5, 12, 14, 21}},
-    {14, {13, 15}},
-    {15, {7, 8, 14, 23}},
-    {16, {17, 23}},
-    {17, {9, 16, 18}},
-    {18, {17, 19}},
-    {19, {11, 18, 20}},
-    {20, {19, 21}},
-    {21, {13, 20, 22}},
-    {22, {21, 23}},
-    {23, {15, 16, 22}},
-};
+    static const uint32_t ODD = 0xaaaaaa;           // the middles of the ring lines
+    static const uint32_t CROSS_MIDDLES = 0xaa00;   // the middles of the cross lines
+
+    // Position k of every ring moves to k + 1
+    static uint32_t RotateClockwise(uint32_t mask) {
+        return ((mask << 1) & 0xfefefe) | ((mask >> 7) & 0x010101);
+    }
 
-const array<array<size_t, 3>, 16> Board::sans = {{
-    {0, 1, 2},
-    {2, 3, 4},
-    {4, 5, 6},
-    {6, 7, 0},
-    {8, 9, 10},
-    {10, 11, 12},
-    {12, 13, 14},
-    {14, 15, 8},
-    {16, 17, 18},
-    {18, 19, 20},
-    {20, 21, 22},
-    {22, 23, 16},
-    {1, 9, 17},
-    {3, 11, 19},
-    {5, 13, 21},
-    {7, 15, 23}
-}};
-
-const unordered_map<size_t, array<array<size_t, 3>, 2>> Board::luPosSan = {
-    {0,  {{0,1,2,      6,7,0}}},
-    {1,  {{0,1,2,      1,9,17}}},
-    {2,  {{0,1,2,      2,3,4}}},
-    {3,  {{2,3,4,      3,11,19}}},
-    {4,  {{2,3,4,      4,5,6}}},
-    {5,  {{4,5,6,      5,13,21}}},
-    {6,  {{4,5,6,      6,7,0}}},
-    {7,  {{6,7,0,      7,15,23}}},
-    {8,  {{8,9,10,     14,15,8}}},
-    {9,  {{8,9,10,     1,9,17}}},
-    {10, {{8,9,10,     10,11,12}}},
-    {11, {{10,11,12,   3,11,19}}},
-    {12, {{10,11,12,   12,13,14}}},
-    {13, {{12,13,14,   5,13,21}}},
-    {14, {{12,13,14,   14,15,8}}},
-    {15, {{14,15,8,    7,15,23}}},
-    {16, {{16,17,18,   22,23,16}}},
-    {17, {{16,17,18,   1,9,17}}},
-    {18, {{16,17,18,   18,19,20}}},
-    {19, {{18,19,20,   3,11,19}}},
-    {20, {{18,19,20,   20,21,22}}},
-    {21, {{20,21,22,   5,13,21}}},
-    {22, {{20,21,22,   22,23,16}}},
-    {23, {{22,23,16,   7,15,23}}}
+    // Position k of every ring moves to k - 1
+    static uint32_t RotateAnticlockwise(uint32_t mask) {
+        return ((mask >> 1) & 0x7f7f7f) | ((mask << 7) & 0x808080);
+    }
+
+    // Given the 3 members of the lines seen from their middles, the middles where 2 are pieces and the other is empty
+    static uint32_t OpenMiddles(uint32_t middle, uint32_t before, uint32_t after,
+                                uint32_t middleEmpty, uint32_t beforeEmpty, uint32_t afterEmpty) {
+        return (before & after & middleEmpty) | (middle & after & beforeEmpty) | (middle & before & afterEmpty);
+    }
+
+    // Positions of pieces in a full line, lines are found by their middles and spread back to 3 positions
+    static uint32_t FullSanPositions(uint32_t pieces) {
+        uint32_t ring = pieces & RotateClockwise(pieces) & RotateAnticlockwise(pieces) & ODD;
+        uint32_t cross = pieces & pieces << 8 & pieces >> 8 & CROSS_MIDDLES;
+        return ring | RotateClockwise(ring) | RotateAnticlockwise(ring) | cross | cross << 8 | cross >> 8;
+    }
+
+    // One bit per position, empty positions are the ones in none of the masks
+    uint32_t firstMask, secondMask, blockMask;
+    uint64_t key;
 };
 
+static_assert(sizeof(Board) <= 24, "Board should stay a small value");
+static_assert(is_trivially_copyable<Board>::value, "Board should be copied with memcpy");
+
+constexpr size_t BoardTables::SANS[BoardTables::SAN_NUMBER][3];
+constexpr BoardTables Board::tables;
+constexpr ZobristTables Board::zobrist;
+
+static_assert(Board::tables.nexts[9] == ((1u << 1) | (1u << 8) | (1u << 10) | (1u << 17)), "neighbours of 9");
+static_assert(Board::tables.luPosSan[23][0] == ((1u << 22) | (1u << 23) | (1u << 16)), "lines through 23");
+
 #endif /* board_h */
@@ -0,0 +1,264 @@
+//
+//  book.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef book_h
+#define book_h
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "board.h"
+#include "alphabeta.h"
+#include "symmetry.h"
+#include "threadpool.h"
+
+using namespace std;
+
+/*
+ Opening book of the placement phase: the best step of a board for the player
+ to move, found by a deep search ahead of time.
+
+ File layout: a BookHeader, then entryNumber BookEntry sorted by key. Boards
+ are stored once per symmetry class: the key is Symmetry::CanonicalHash and the
+ move is the step on the canonical board. The book maps the file and binary
+ searches the entries in place.
+ */
+struct BookHeader {
+    static constexpr const char* MAGIC = "CSBK0002";
+
+    char magic[8];
+    uint64_t entryNumber;
+};
+
+struct BookEntry {
+    uint64_t key;
+    uint16_t move;      // Step::Encode() of the best step
+    int16_t score;      // alpha-beta score for the player to move
+    uint16_t depth;     // depth of the search that found it
+    uint16_t reserved;
+
+    bool operator<(const BookEntry& other) const {
+        return key < other.key;
+    }
+};
+
+class OpeningBook {
+public:
+    OpeningBook()
+    :data(NULL), size(0), entries(NULL), entryNumber(0) {
+    }
+
+    ~OpeningBook() {
+        Close();
+    }
+
+    OpeningBook(const OpeningBook&) = delete;
+    OpeningBook& operator=(const OpeningBook&) = delete;
+
+    // Book the engines check before searching, NULL when none was opened
+    static const OpeningBook*& Shared() {
+        static const OpeningBook* shared = NULL;
+        return shared;
+    }
+
+    bool Open(const char* path) {
+        Close();
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BookHeader)) {
+            close(fd);
+            return false;
+        }
+        void* mapped = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            return false;
+        }
+        data = (const uint8_t*)mapped;
+        size = (size_t)st.st_size;
+
+        const BookHeader& header = *(const BookHeader*)data;
+        if (memcmp(header.magic, BookHeader::MAGIC, 8) != 0
+            || sizeof(BookHeader) + header.entryNumber * sizeof(BookEntry) > size) {
+            Close();
+            return false;
+        }
+        entries = (const BookEntry*)(data + sizeof(BookHeader));
+        entryNumber = (size_t)header.entryNumber;
+        return true;
+    }
+
+    void Close() {
+        if (data) {
+            munmap((void*)data, size);
+        }
+        data = NULL;
+        size = 0;
+        entries = NULL;
+        entryNumber = 0;
+    }
+
+    size_t Size() const {
+        return entryNumber;
+    }
+
+    // The book step of board for playerToMove, false if the board is not in the book
+    bool Probe(const Board& board, int playerToMove, int round, Step& step, BookEntry* found = NULL) const {
+        if (!entries || round >= 9) {
+            return false;
+        }
+        BookEntry target;
+        int transform;
+        target.key = Symmetry::CanonicalHash(board, playerToMove, round, &transform);
+        const BookEntry* entry = lower_bound(entries, entries + entryNumber, target);
+        if (entry == entries + entryNumber || entry->key != target.key) {
+            return false;
+        }
+
+        // a key collision could give a step that is not possible here
+        Step candidate = Symmetry::Apply(Symmetry::Inverse(transform), Step::Decode(entry->move, playerToMove));
+        MoveList steps;
+        board.FindPossibleSteps(playerToMove, round, steps);
+        if (find(steps.begin(), steps.end(), candidate) == steps.end()) {
+            return false;
+        }
+        step = candidate;
+        if (found) {
+            *found = *entry;
+        }
+        return true;
+    }
+private:
+    const uint8_t* data;
+    size_t size;
+    const BookEntry* entries;
+    size_t entryNumber;
+};
+
+/*
+ Builds a book for both players. For each player the placement tree is walked
+ plies deep: where the player is to move only the searched best step is
+ followed, where the opponent is to move every step is, so the book answers
+ any opening the opponent tries. Transpositions and symmetric boards are
+ walked once.
+ */
+class BookBuilder {
+public:
+    BookBuilder(int plies, const SearchLimits& limits, size_t threads = 1)
+    :plies(plies), limits(limits), pool(new ThreadPool(max(threads, (size_t)1))) {
+        for (size_t i = 0; i < pool->Size(); ++i) {
+            searchers.emplace_back(new AlphaBetaPlayer(Board::FIRST_TAG, Board::SECOND_TAG, 4));
+            searchers.emplace_back(new AlphaBetaPlayer(Board::SECOND_TAG, Board::FIRST_TAG, 4));
+        }
+    }
+
+    // Build the book, progress goes to log when it is not NULL
+    void Build(FILE* log = NULL) {
+        entries.clear();
+        for (int tag = Board::FIRST_TAG; tag <= Board::SECOND_TAG; ++tag) {
+            BuildFor(tag, log);
+        }
+        sort(entries.begin(), entries.end());
+        entries.erase(unique(entries.begin(), entries.end(), [](const BookEntry& a, const BookEntry& b) {
+            return a.key == b.key;
+        }), entries.end());
+    }
+
+    bool Write(const char* path) const {
+        FILE* file = fopen(path, "wb");
+        if (!file) {
+            return false;
+        }
+        BookHeader header;
+        memcpy(header.magic, BookHeader::MAGIC, 8);
+        header.entryNumber = entries.size();
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+            && fwrite(entries.data(), sizeof(BookEntry), entries.size(), file) == entries.size();
+        return fclose(file) == 0 && ok;
+    }
+private:
+    struct Position {
+        Board board;
+        int toMove;
+        int round;
+    };
+
+    void BuildFor(int bookTag, FILE* log) {
+        vector<Position> level(1, Position{Board(), Board::FIRST_TAG, 0});
+        for (int ply = 0; ply < plies && !level.empty(); ++ply) {
+            vector<Position> next;
+            unordered_set<uint64_t> seen;
+            auto push = [&](const Board& board, const Step& step, int toMove, int round) {
+                Board child = board;
+                child.ApplyStep(step, round);
+                int winner, childRound = Board::NextRound(toMove, round);
+                if (child.IsOver(winner, round) || childRound >= 9) {
+                    return;
+                }
+                if (seen.insert(Symmetry::CanonicalHash(child, Board::Opponent(toMove), childRound)).second) {
+                    next.push_back(Position{child, Board::Opponent(toMove), childRound});
+                }
+            };
+
+            if (level[0].toMove != bookTag) {
+                for (auto& position: level) {
+                    for (auto& step: position.board.FindPossibleSteps(position.toMove, position.round)) {
+                        push(position.board, step, position.toMove, position.round);
+                    }
+                }
+            } else {
+                vector<BookEntry> found(level.size());
+                for (size_t i = 0; i < level.size(); ++i) {
+                    pool->Submit([this, &level, &found, i](size_t worker) {
+                        const Position& position = level[i];
+                        AlphaBetaPlayer& searcher = *searchers[2 * worker + (position.toMove == Board::SECOND_TAG)];
+                        SearchInfo info;
+                        Step best = searcher.Search(position.board, position.round, limits, &info);
+                        int transform;
+                        found[i].key = Symmetry::CanonicalHash(position.board, position.toMove, position.round, &transform);
+                        found[i].move = Symmetry::Apply(transform, best).Encode();
+                        found[i].score = (int16_t)info.score;
+                        found[i].depth = (uint16_t)info.depth;
+                        found[i].reserved = 0;
+                    });
+                }
+                pool->Wait();
+                for (size_t i = 0; i < level.size(); ++i) {
+                    entries.push_back(found[i]);
+                    int transform = Symmetry::CanonicalTransform(level[i].board);
+                    Step best = Symmetry::Apply(Symmetry::Inverse(transform), Step::Decode(found[i].move, bookTag));
+                    push(level[i].board, best, bookTag, level[i].round);
+                }
+            }
+
+            if (log) {
+                fprintf(log, "player %d ply %d: %zu boards, %zu entries\n", bookTag, ply, level.size(), entries.size());
+                fflush(log);
+            }
+            level.swap(next);
+        }
+    }
+
+    int plies;
+    SearchLimits limits;
+    unique_ptr<ThreadPool> pool;
+    vector<unique_ptr<AlphaBetaPlayer>> searchers;     // a first and a second player searcher per worker
+    vector<BookEntry> entries;
+};
+
+#endif /* book_h */
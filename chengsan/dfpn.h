@@ -0,0 +1,243 @@
+//
+//  dfpn.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef dfpn_h
+#define dfpn_h
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "board.h"
+#include "instrument.h"
+
+using namespace std;
+
+/*
+ Depth-first proof-number search (df-pn) for forced wins. A search proves that
+ the attacker wins whatever the defender does: the attacker's nodes need one
+ proved child, the defender's need all of them. Proof and disproof numbers
+ live in a transposition table keyed by Board::Hash.
+
+ A repetition on the current path and the horizon count as disproved, as the
+ attacker has not won there. Both depend on the path and may leave wrong
+ disproofs in the table, but a proof is only ever built from finished games, so
+ every WIN and LOSS the solver reports is exact. Running out of budget or a
+ disproof is UNKNOWN.
+
+ Without a horizon df-pn happily follows the long lines of the moving phase
+ where the defender has few steps, so the horizon deepens from MIN_DEPTH to
+ MAX_DEPTH, keeping only the proofs of the table each time, and short forced wins come out of
+ the first, cheap iterations.
+ */
+class ProofSolver {
+public:
+    enum Result {
+        UNKNOWN,
+        WIN,        // the player to move wins by force, with the returned step
+        LOSS        // every step of the player to move loses by force
+    };
+
+    static const uint64_t DEFAULT_BUDGET = 20000;
+    static const uint64_t PREPASS_BUDGET = 2000;     // a few milliseconds, before the engines search
+    static const int MIN_DEPTH = 8;
+    static const int MAX_DEPTH = 48;
+
+    explicit ProofSolver(size_t tableEntries = 1 << 18)
+    :table(tableEntries), nodes(0), budget(0), horizon(MAX_DEPTH) {
+    }
+
+    /*
+     Try to prove board won or lost for toMove in round, visiting at most budget
+     nodes. Half the budget goes to the win; the loss gets what is left.
+     */
+    Result Solve(const Board& board, int toMove, int round, uint64_t budget, Step& move) {
+        if (ProveWin(board, toMove, round, budget / 2, move)) {
+            return WIN;
+        }
+        Board scratch = board;
+        if (Prove(scratch, toMove, round, Board::Opponent(toMove), budget - nodes)) {
+            return LOSS;
+        }
+        return UNKNOWN;
+    }
+
+    // The win half of Solve alone, true with the winning step in move
+    bool ProveWin(const Board& board, int toMove, int round, uint64_t budget, Step& move) {
+        INSTRUMENT_TRACE("ProofSolver");
+        nodes = 0;
+        Board scratch = board;
+        if (Prove(scratch, toMove, round, toMove, budget)) {
+            move = proving;
+            return true;
+        }
+        return false;
+    }
+
+    // Nodes visited by the last Solve
+    uint64_t Nodes() const {
+        return nodes;
+    }
+private:
+    static const uint32_t INF = 0x3fffffff;
+
+    struct Numbers {
+        uint32_t pn, dn;
+    };
+
+    struct Entry {
+        uint64_t key;       // 0 for an empty entry
+        Numbers numbers;
+    };
+
+    // True if attacker wins from board, toMove to move in round, within budget nodes
+    bool Prove(Board& board, int toMove, int round, int attacker, uint64_t limit) {
+        budget = nodes + limit;
+        fill(table.begin(), table.end(), Entry{0, {0, 0}});
+        for (horizon = MIN_DEPTH; nodes < budget; horizon = min(horizon * 2, MAX_DEPTH)) {
+            // proofs hold at any horizon, the rest may come from the old one
+            for (auto& entry: table) {
+                if (entry.numbers.pn != 0) {
+                    entry.key = 0;
+                }
+            }
+            path.clear();
+            if (Search(board, toMove, round, attacker, INF - 1, INF - 1, 0).pn == 0) {
+                return true;
+            }
+            if (horizon == MAX_DEPTH) {
+                break;
+            }
+        }
+        return false;
+    }
+
+    // MID of df-pn: search board until its numbers reach one of the thresholds
+    Numbers Search(Board& board, int toMove, int round, int attacker, uint32_t thresholdPn, uint32_t thresholdDn,
+                   int depth) {
+        uint64_t key = board.Hash(toMove, round);
+        nodes++;
+        if (depth >= horizon) {
+            return Numbers{INF, 0};
+        }
+
+        MoveList steps;
+        board.FindPossibleSteps(toMove, round, steps);
+        bool attacking = toMove == attacker;
+        int next = Board::Opponent(toMove), nextRound = Board::NextRound(toMove, round);
+        path.push_back(key);
+
+        // the numbers of the children, from the table or from a finished game
+        Numbers children[MoveList::MAX_STEPS];
+        for (size_t i = 0; i < steps.size(); ++i) {
+            StepUndo undo = board.DoStep(steps[i], round);
+            children[i] = Child(board, next, nextRound, round, attacker);
+            board.UndoStep(undo);
+        }
+
+        Numbers numbers;
+        while (true) {
+            numbers = Combine(children, steps.size(), attacking);
+            Store(key, numbers);
+            if (numbers.pn >= thresholdPn || numbers.dn >= thresholdDn || nodes >= budget) {
+                break;
+            }
+
+            // the most proving child, and the second best value bounding its threshold
+            size_t best = 0;
+            uint32_t second = INF;
+            for (size_t i = 1; i < steps.size(); ++i) {
+                if (Key(children[i], attacking) < Key(children[best], attacking)) {
+                    second = Key(children[best], attacking);
+                    best = i;
+                } else {
+                    second = min(second, Key(children[i], attacking));
+                }
+            }
+            uint32_t childPn, childDn;
+            if (attacking) {
+                childPn = min(thresholdPn, Add(second, 1));
+                childDn = Add(thresholdDn - numbers.dn, children[best].dn);
+            } else {
+                childDn = min(thresholdDn, Add(second, 1));
+                childPn = Add(thresholdPn - numbers.pn, children[best].pn);
+            }
+
+            // what the child returns also covers the repetitions and the horizon, which are not stored
+            StepUndo undo = board.DoStep(steps[best], round);
+            children[best] = Search(board, next, nextRound, attacker, childPn, childDn, depth + 1);
+            board.UndoStep(undo);
+        }
+        path.pop_back();
+        if (depth == 0 && attacking && numbers.pn == 0) {
+            for (size_t i = 0; i < steps.size(); ++i) {
+                if (children[i].pn == 0) {
+                    proving = steps[i];
+                    break;
+                }
+            }
+        }
+        return numbers;
+    }
+
+    // Numbers of the board a step of the node in round led to, next is to move in nextRound
+    Numbers Child(const Board& board, int next, int nextRound, int round, int attacker) {
+        int winner;
+        if (board.IsOver(winner, round)) {
+            return winner == attacker ? Numbers{0, INF} : Numbers{INF, 0};
+        }
+        uint64_t key = board.Hash(next, nextRound);
+        if (find(path.begin(), path.end(), key) != path.end()) {
+            return Numbers{INF, 0};
+        }
+        const Entry& entry = table[key & (table.size() - 1)];
+        if (entry.key == key) {
+            return entry.numbers;
+        }
+        return Numbers{1, 1};
+    }
+
+    // The attacker needs one proved child, the defender needs one disproved child
+    static Numbers Combine(const Numbers* children, size_t count, bool attacking) {
+        Numbers res = attacking ? Numbers{INF, 0} : Numbers{0, INF};
+        for (size_t i = 0; i < count; ++i) {
+            if (attacking) {
+                res.pn = min(res.pn, children[i].pn);
+                res.dn = Add(res.dn, children[i].dn);
+            } else {
+                res.pn = Add(res.pn, children[i].pn);
+                res.dn = min(res.dn, children[i].dn);
+            }
+        }
+        return res;
+    }
+
+    // What the node minimizes over its children
+    static uint32_t Key(const Numbers& numbers, bool attacking) {
+        return attacking ? numbers.pn : numbers.dn;
+    }
+
+    static uint32_t Add(uint32_t a, uint32_t b) {
+        return min(a + b, INF);
+    }
+
+    void Store(uint64_t key, const Numbers& numbers) {
+        table[key & (table.size() - 1)] = Entry{key, numbers};
+    }
+
+    vector<Entry> table;        // one entry per slot, always replaced
+    vector<uint64_t> path;      // keys from the root to the node searched
+    uint64_t nodes;
+    uint64_t budget;            // nodes stops growing once it gets here
+    int horizon;                // depth of the current iteration
+    Step proving;               // the step proving the root won
+};
+
+const uint32_t ProofSolver::INF;
+const int ProofSolver::MAX_DEPTH;
+
+#endif /* dfpn_h */
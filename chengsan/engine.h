@@ -0,0 +1,170 @@
+//
+//  engine.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef engine_h
+#define engine_h
+
+#include <atomic>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <thread>
+#include "board.h"
+#include "player.h"
+#include "mcts.h"
+#include "alphabeta.h"
+#include "book.h"
+#include "dfpn.h"
+#include "search.h"
+#include "instrument.h"
+
+using namespace std;
+
+// Which search picks the steps of a player, and how much it may search
+struct EngineConfig {
+    enum Type {
+        MONTE_CARLO,
+        MCTS,
+        ALPHA_BETA,
+        HUMAN
+    };
+
+    EngineConfig(Type type = MCTS, const SearchLimits& limits = SearchLimits(), size_t threads = 1, bool ponder = false)
+    :type(type), limits(limits), threads(threads), ponder(ponder), solverNodes(ProofSolver::PREPASS_BUDGET) {
+    }
+
+    static const char* TypeName(Type type) {
+        static const char* names[] = {"mc", "mcts", "ab", "human"};
+        return names[type];
+    }
+
+    // Parse a type name of TypeName, false if there is no such type
+    static bool ParseType(const string& name, Type& type) {
+        for (int t = MONTE_CARLO; t <= HUMAN; ++t) {
+            if (name == TypeName((Type)t)) {
+                type = (Type)t;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    Type type;
+    SearchLimits limits;
+    size_t threads;     // of MonteCarlo playouts and Lazy SMP alpha-beta
+    bool ponder;        // MCTS keeps searching on the opponent's time
+    uint64_t solverNodes;   // budget of the forced win check before every search, 0 skips it
+};
+
+/*
+ One player of a game driven by the engine its config asks for. The searches
+ are only created when needed, they hold large tables.
+ */
+class Engine {
+public:
+    Engine(int selfTag, const EngineConfig& config = EngineConfig(), uint64_t seed = (uint64_t)time(NULL))
+    :tag(selfTag), seed(seed), self(selfTag, Board::Opponent(selfTag), seed),
+    opponent(Board::Opponent(selfTag), selfTag, seed) {
+        Configure(config);
+    }
+
+    ~Engine() {
+        StopPondering();
+    }
+
+    int Tag() const {
+        return tag;
+    }
+
+    const EngineConfig& Config() const {
+        return config;
+    }
+
+    void Configure(const EngineConfig& c) {
+        StopPondering();
+        config = c;
+        self.SetThreads(config.type == EngineConfig::MONTE_CARLO ? config.threads : 1);
+        mcts.reset(config.type == EngineConfig::MCTS ? new MctsPlayer(tag, Board::Opponent(tag), seed) : NULL);
+        alphaBeta.reset(config.type == EngineConfig::ALPHA_BETA
+                        ? new AlphaBetaPlayer(tag, Board::Opponent(tag), 16, config.threads) : NULL);
+        solver.reset(config.type != EngineConfig::HUMAN && config.solverNodes > 0 ? new ProofSolver(SOLVER_ENTRIES) : NULL);
+    }
+
+    void SetLimits(const SearchLimits& limits) {
+        config.limits = limits;
+    }
+
+    Step Think(const Board& board, int round, SearchInfo* info = NULL) {
+        INSTRUMENT_TRACE("Think");
+        StopPondering();
+        const OpeningBook* book = OpeningBook::Shared();
+        Step step = Step::MakePlaceStep(tag, Step::NONE_POS);
+        BookEntry entry;
+        if (config.type != EngineConfig::HUMAN && book && book->Probe(board, tag, round, step, &entry)) {
+            if (info) {
+                info->depth = entry.depth;
+                info->score = entry.score;
+            }
+            return step;
+        }
+        // a forced win is played at once, sampling could still miss it
+        SearchClock clock(config.limits);
+        if (solver && solver->ProveWin(board, tag, round, config.solverNodes, step)) {
+            if (info) {
+                clock.Finish(*info, 0, solver->Nodes(), false);
+                info->score = AlphaBetaPlayer::WIN_SCORE;
+                info->proved = true;
+            }
+            return step;
+        }
+
+        switch (config.type) {
+            case EngineConfig::MONTE_CARLO:
+                return self.MonteCarlo(board, round, opponent, tag == Board::FIRST_TAG, config.limits, info);
+            case EngineConfig::MCTS:
+                step = mcts->Search(board, round, config.limits, info);
+                if (config.ponder) {
+                    StartPondering();
+                }
+                return step;
+            case EngineConfig::ALPHA_BETA:
+                return alphaBeta->Search(board, round, config.limits, info);
+            default:
+                return self.Human(board, round);
+        }
+    }
+private:
+    static const size_t SOLVER_ENTRIES = 1 << 15;   // enough for the pre-pass budget
+
+    // Search the tree of the last step on a thread of its own until StopPondering
+    void StartPondering() {
+        ponderCancel = false;
+        ponderThread = thread([this] {
+            mcts->Ponder(ponderCancel);
+        });
+    }
+
+    void StopPondering() {
+        if (ponderThread.joinable()) {
+            ponderCancel = true;
+            ponderThread.join();
+        }
+    }
+
+    int tag;
+    uint64_t seed;
+    EngineConfig config;
+    Player self, opponent;
+    unique_ptr<MctsPlayer> mcts;
+    unique_ptr<AlphaBetaPlayer> alphaBeta;
+    unique_ptr<ProofSolver> solver;
+    thread ponderThread;
+    atomic<bool> ponderCancel;
+};
+
+#endif /* engine_h */
@@ -10,37 +10,106 @@
 #define game_h
 
 #include "board.h"
-#include "player.h"
+#include "engine.h"
+#include "record.h"
+#include "instrument.h"
+#include <chrono>
 #include <cstdio>
 
+// What the searches of one player cost over a game
+struct PlayerStats {
+    PlayerStats()
+    :steps(0), micros(0), playouts(0), nodes(0) {
+    }
+
+    void Add(const SearchInfo& info) {
+        steps++;
+        micros += info.micros;
+        playouts += info.playouts;
+        nodes += info.nodes;
+    }
+
+    uint64_t steps;
+    int64_t micros;
+    uint64_t playouts;
+    uint64_t nodes;
+};
+
 class Game {
 public:
-    Game()
-    :first(Board::FIRST_TAG, Board::SECOND_TAG),
-    second(Board::SECOND_TAG, Board::FIRST_TAG), round(0) {
+    // The engines are built from their configs at once, SetEngine rebuilds one
+    Game(uint64_t seed = (uint64_t)time(NULL), const EngineConfig& firstConfig = EngineConfig(),
+         const EngineConfig& secondConfig = EngineConfig())
+    :first(Board::FIRST_TAG, firstConfig, Utils::Mix(seed, Board::FIRST_TAG)),
+    second(Board::SECOND_TAG, secondConfig, Utils::Mix(seed, Board::SECOND_TAG)), round(0), seed(seed),
+    verbose(true), profile(false), maxRounds(0), recorder(NULL) {
+    }
+
+    // Print every board and search, on by default
+    void SetVerbose(bool v) {
+        verbose = v;
+    }
+
+    // Print what every search counted and timed after its board, needs verbose
+    void SetProfile(bool p) {
+        profile = p;
+    }
+
+    // A game still going after rounds rounds is a draw, 0 plays on until someone wins
+    void SetMaxRounds(int rounds) {
+        maxRounds = rounds;
+    }
+
+    // Append the game to recorder when it ends, NULL records nothing
+    void SetRecorder(GameRecorder* r) {
+        recorder = r;
+    }
+
+    int Round() const {
+        return round;
+    }
+
+    const PlayerStats& Stats(int playerTag) const {
+        return playerTag == Board::FIRST_TAG ? firstStats : secondStats;
     }
 
-    void Run() {
+    // Engine of the player with playerTag
+    void SetEngine(int playerTag, const EngineConfig& config) {
+        (playerTag == Board::FIRST_TAG ? first : second).Configure(config);
+    }
+
+    // Limits of every search of the player with playerTag
+    void SetLimits(int playerTag, const SearchLimits& limits) {
+        (playerTag == Board::FIRST_TAG ? first : second).SetLimits(limits);
+    }
+
+    // Play the game to its end, returns the winner or 0 for a draw
+    int Run() {
         int winner;
         while (true) {
-            board.ApplyStep(first.MonteCarlo(board, round, second, true), round);
-            PrintBoard();
-            if (board.IsOver(winner, round)) {
+            if (Play(first, firstStats, winner)) {
                 break;
             }
-            
-            board.ApplyStep(second.MonteCarlo(board, round, first, false), round);
-//            board.ApplyStep(second.Human(board, round), round);
-            PrintBoard();
-            if (board.IsOver(winner, round)) {
+            if (Play(second, secondStats, winner)) {
                 break;
             }
 
             round++;
+            if (maxRounds > 0 && round >= maxRounds) {
+                winner = 0;
+                break;
+            }
 //            cin.get();
         }
 
-        cout << "Winner: Player " << winner << endl;
+        if (recorder) {
+            recorder->Write(GameRecordHeader::Make(seed, first.Config(), second.Config(), maxRounds, plies.size()),
+                            plies, winner);
+        }
+        if (verbose) {
+            cout << "Winner: Player " << winner << endl;
+        }
+        return winner;
     }
 
     void PrintBoard() const {
@@ -87,10 +156,49 @@ public:
                 tags[board.At(4)]);
         printf("1st: %ld on board | 2nd: %ld on board\n", board.FindFirst().size(), board.FindSecond().size());
     }
+
+    void PrintSearchInfo(int playerTag, const SearchInfo& info) const {
+        const Engine& engine = playerTag == Board::FIRST_TAG ? first : second;
+        printf("Player %d (%s): %llu playouts, %llu nodes, depth %d in %.1f ms%s\n", playerTag,
+               EngineConfig::TypeName(engine.Config().type),
+               (unsigned long long)info.playouts, (unsigned long long)info.nodes, info.depth, info.micros / 1000.0,
+               info.proved ? " (proved win)" : info.cutOff ? " (cut off)" : "");
+    }
 private:
+    // One step of engine, true if it ends the game
+    bool Play(Engine& engine, PlayerStats& stats, int& winner) {
+        SearchInfo info;
+        Instrument::Snapshot before = profile ? Instrument::Total() : Instrument::Snapshot();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        Step step = engine.Think(board, round, &info);
+        if (recorder) {
+            // the wall clock of the whole step, book and solver hits included
+            int64_t micros = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+            plies.push_back(RecordPly{step.Encode(), RecordPly::PackLatency(micros)});
+        }
+        board.ApplyStep(step, round);
+        stats.Add(info);
+        if (verbose) {
+            PrintBoard();
+            PrintSearchInfo(engine.Tag(), info);
+            if (profile) {
+                // every thread of the process counts, so this is only exact when one game runs at a time
+                Instrument::PrintSummary(Instrument::Total() - before);
+            }
+        }
+        return board.IsOver(winner, round);
+    }
+
     Board board;
     int round;
-    Player first, second;
+    Engine first, second;
+    PlayerStats firstStats, secondStats;
+    uint64_t seed;
+    bool verbose;
+    bool profile;
+    int maxRounds;
+    GameRecorder* recorder;
+    vector<RecordPly> plies;    // of the game so far, only kept for the recorder
 };
 
 #endif /* game_h */
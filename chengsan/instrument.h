@@ -0,0 +1,369 @@
+//
+//  instrument.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef instrument_h
+#define instrument_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+/*
+ Counters, timers and trace events of the searches. Every thread writes its own
+ block, registered on first use, so recording never contends; when the thread
+ exits its block is folded into a retired total and freed. Total sums the
+ retired total and the blocks of the live threads.
+
+ Counters are always on. Timers and trace events read the clock, so they only
+ record once SetTiming or SetTracing turned them on. Build with
+ CHENGSAN_NO_INSTRUMENT defined and the INSTRUMENT_ macros compile to nothing.
+ */
+class Instrument {
+public:
+    enum Counter {
+        CANDIDATES,         // root steps MonteCarlo scored
+        EARLY_RETURNS,      // MonteCarlo searches ended by a root step that wins at once
+        LOSING_CANDIDATES,  // root steps that lose at once, never played out
+        PLAYOUTS,
+        PLAYOUT_PLIES,      // random steps played in playouts and rollouts
+        STEP_LISTS,         // full step lists generated by the engines
+        STEPS_GENERATED,    // steps in those lists
+        STEPS_APPLIED,
+        TERMINAL_CHECKS,
+        TABLEBASE_HITS,     // rollouts the tablebase finished
+        EVALUATIONS,        // boards the n-tuple network scored instead of a rollout or a static score
+        COUNTER_NUMBER
+    };
+
+    enum Timer {
+        MOVE_GENERATION,
+        STEP_APPLICATION,
+        TERMINAL_CHECK,
+        ROLLOUT,            // whole playouts, the other timers run inside them too
+        TIMER_NUMBER
+    };
+
+    // Win rates of the root steps, in buckets of a tenth
+    static const int SCORE_BUCKETS = 10;
+
+    // Everything recorded so far, or between two totals
+    struct Snapshot {
+        Snapshot() {
+            fill(counters, counters + COUNTER_NUMBER, 0);
+            fill(timerNanos, timerNanos + TIMER_NUMBER, 0);
+            fill(timerCalls, timerCalls + TIMER_NUMBER, 0);
+            fill(scores, scores + SCORE_BUCKETS, 0);
+        }
+
+        Snapshot operator-(const Snapshot& other) const {
+            Snapshot res;
+            for (int i = 0; i < COUNTER_NUMBER; ++i) {
+                res.counters[i] = counters[i] - other.counters[i];
+            }
+            for (int i = 0; i < TIMER_NUMBER; ++i) {
+                res.timerNanos[i] = timerNanos[i] - other.timerNanos[i];
+                res.timerCalls[i] = timerCalls[i] - other.timerCalls[i];
+            }
+            for (int i = 0; i < SCORE_BUCKETS; ++i) {
+                res.scores[i] = scores[i] - other.scores[i];
+            }
+            return res;
+        }
+
+        uint64_t counters[COUNTER_NUMBER];
+        uint64_t timerNanos[TIMER_NUMBER];
+        uint64_t timerCalls[TIMER_NUMBER];
+        uint64_t scores[SCORE_BUCKETS];
+    };
+
+    static void SetTiming(bool on) {
+        TimingFlag().store(on, memory_order_relaxed);
+    }
+
+    static bool Timing() {
+        return TimingFlag().load(memory_order_relaxed);
+    }
+
+    static void SetTracing(bool on) {
+        TracingFlag().store(on, memory_order_relaxed);
+    }
+
+    static bool Tracing() {
+        return TracingFlag().load(memory_order_relaxed);
+    }
+
+    static void Count(Counter counter, uint64_t n = 1) {
+        Add(Local().counters[counter], n);
+    }
+
+    static void AddTime(Timer timer, uint64_t nanos) {
+        ThreadData& data = Local();
+        Add(data.timerNanos[timer], nanos);
+        Add(data.timerCalls[timer], 1);
+    }
+
+    static void AddScore(double winRate) {
+        int bucket = (int)(winRate * SCORE_BUCKETS);
+        Add(Local().scores[min(max(bucket, 0), SCORE_BUCKETS - 1)], 1);
+    }
+
+    // Nanoseconds on the clock of the timers and trace events
+    static int64_t Now() {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - Epoch()).count();
+    }
+
+    // A finished event of this thread, name must outlive the trace (a literal)
+    static void AddTraceEvent(const char* name, int64_t startNanos, int64_t endNanos) {
+        ThreadData& data = Local();
+        lock_guard<mutex> lock(data.mtx);
+        data.events.push_back(TraceEvent{name, startNanos, endNanos});
+    }
+
+    static Snapshot Total() {
+        Registry& registry = Threads();
+        lock_guard<mutex> lock(registry.mtx);
+        Snapshot total = registry.retired;
+        for (auto& data: registry.threads) {
+            AddTo(total, *data);
+        }
+        return total;
+    }
+
+    static void PrintSummary(const Snapshot& s, FILE* out = stdout) {
+        const uint64_t* c = s.counters;
+        fprintf(out, "  candidates %llu (%llu lose at once), early returns %llu\n",
+                (unsigned long long)c[CANDIDATES], (unsigned long long)c[LOSING_CANDIDATES],
+                (unsigned long long)c[EARLY_RETURNS]);
+        fprintf(out, "  playouts %llu, %.1f plies each, %llu tablebase hits, %llu network evaluations\n",
+                (unsigned long long)c[PLAYOUTS], c[PLAYOUTS] ? (double)c[PLAYOUT_PLIES] / c[PLAYOUTS] : 0.0,
+                (unsigned long long)c[TABLEBASE_HITS], (unsigned long long)c[EVALUATIONS]);
+        fprintf(out, "  step lists %llu (%llu steps), steps applied %llu, terminal checks %llu\n",
+                (unsigned long long)c[STEP_LISTS], (unsigned long long)c[STEPS_GENERATED],
+                (unsigned long long)c[STEPS_APPLIED], (unsigned long long)c[TERMINAL_CHECKS]);
+        if (Timing()) {
+            static const char* names[TIMER_NUMBER] = {"move generation", "step application", "terminal check", "rollout"};
+            for (int i = 0; i < TIMER_NUMBER; ++i) {
+                fprintf(out, "  %-16s %10.3f ms in %llu calls, %.0f ns each\n", names[i], s.timerNanos[i] / 1e6,
+                        (unsigned long long)s.timerCalls[i],
+                        s.timerCalls[i] ? (double)s.timerNanos[i] / s.timerCalls[i] : 0.0);
+            }
+        }
+        uint64_t scored = 0;
+        for (int i = 0; i < SCORE_BUCKETS; ++i) {
+            scored += s.scores[i];
+        }
+        if (scored > 0) {
+            fprintf(out, "  win rates:");
+            for (int i = 0; i < SCORE_BUCKETS; ++i) {
+                fprintf(out, " %d%%:%llu", i * 100 / SCORE_BUCKETS, (unsigned long long)s.scores[i]);
+            }
+            fprintf(out, "\n");
+        }
+    }
+
+    // Every trace event so far as Chrome trace event JSON, for chrome://tracing or Perfetto
+    static bool WriteTrace(const char* path) {
+        FILE* file = fopen(path, "w");
+        if (!file) {
+            return false;
+        }
+        fprintf(file, "{\"traceEvents\":[\n");
+        bool first = true;
+        Registry& registry = Threads();
+        lock_guard<mutex> registryLock(registry.mtx);
+        for (auto& trace: registry.retiredTraces) {
+            WriteEvents(file, trace.id, trace.events, first);
+        }
+        for (auto& data: registry.threads) {
+            lock_guard<mutex> lock(data->mtx);
+            WriteEvents(file, data->id, data->events, first);
+        }
+        fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+        return fclose(file) == 0;
+    }
+
+    // Adds the time from construction to destruction to a timer, when timing is on
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Timer timer)
+        :timer(timer), start(Timing() ? Now() : -1) {
+        }
+
+        ~ScopedTimer() {
+            if (start >= 0) {
+                AddTime(timer, (uint64_t)(Now() - start));
+            }
+        }
+    private:
+        Timer timer;
+        int64_t start;
+    };
+
+    // A trace event from construction to destruction, when tracing is on
+    class ScopedTrace {
+    public:
+        explicit ScopedTrace(const char* name)
+        :name(name), start(Tracing() ? Now() : -1) {
+        }
+
+        ~ScopedTrace() {
+            if (start >= 0) {
+                AddTraceEvent(name, start, Now());
+            }
+        }
+    private:
+        const char* name;
+        int64_t start;
+    };
+private:
+    struct TraceEvent {
+        const char* name;
+        int64_t start, end;
+    };
+
+    // Written by its own thread only, so plain loads and stores are enough
+    struct ThreadData {
+        explicit ThreadData(int id)
+        :id(id) {
+            for (auto& c: counters) c.store(0, memory_order_relaxed);
+            for (auto& t: timerNanos) t.store(0, memory_order_relaxed);
+            for (auto& t: timerCalls) t.store(0, memory_order_relaxed);
+            for (auto& s: scores) s.store(0, memory_order_relaxed);
+        }
+
+        int id;
+        atomic<uint64_t> counters[COUNTER_NUMBER];
+        atomic<uint64_t> timerNanos[TIMER_NUMBER];
+        atomic<uint64_t> timerCalls[TIMER_NUMBER];
+        atomic<uint64_t> scores[SCORE_BUCKETS];
+        mutex mtx;      // guards events against WriteTrace
+        vector<TraceEvent> events;
+    };
+
+    // The trace events of a thread that has exited
+    struct RetiredTrace {
+        int id;
+        vector<TraceEvent> events;
+    };
+
+    struct Registry {
+        mutex mtx;
+        vector<unique_ptr<ThreadData>> threads;     // the live ones
+        Snapshot retired;                           // everything the exited threads recorded
+        vector<RetiredTrace> retiredTraces;
+        int nextId = 0;
+    };
+
+    // Registers the block of its thread and retires it when the thread exits
+    struct LocalHolder {
+        LocalHolder()
+        :data(Register()) {
+        }
+
+        ~LocalHolder() {
+            Retire(data);
+        }
+
+        ThreadData* data;
+    };
+
+    static void Add(atomic<uint64_t>& value, uint64_t n) {
+        value.store(value.load(memory_order_relaxed) + n, memory_order_relaxed);
+    }
+
+    static Registry& Threads() {
+        static Registry registry;
+        return registry;
+    }
+
+    static ThreadData& Local() {
+        thread_local LocalHolder holder;
+        return *holder.data;
+    }
+
+    static ThreadData* Register() {
+        Registry& registry = Threads();
+        lock_guard<mutex> lock(registry.mtx);
+        registry.threads.emplace_back(new ThreadData(registry.nextId++));
+        return registry.threads.back().get();
+    }
+
+    // Called on the exiting thread itself, so its block sees no more writes
+    static void Retire(ThreadData* data) {
+        Registry& registry = Threads();
+        lock_guard<mutex> lock(registry.mtx);
+        AddTo(registry.retired, *data);
+        if (!data->events.empty()) {
+            registry.retiredTraces.push_back(RetiredTrace{data->id, move(data->events)});
+        }
+        registry.threads.erase(find_if(registry.threads.begin(), registry.threads.end(),
+                                       [data](const unique_ptr<ThreadData>& p) { return p.get() == data; }));
+    }
+
+    static void AddTo(Snapshot& total, const ThreadData& data) {
+        for (int i = 0; i < COUNTER_NUMBER; ++i) {
+            total.counters[i] += data.counters[i].load(memory_order_relaxed);
+        }
+        for (int i = 0; i < TIMER_NUMBER; ++i) {
+            total.timerNanos[i] += data.timerNanos[i].load(memory_order_relaxed);
+            total.timerCalls[i] += data.timerCalls[i].load(memory_order_relaxed);
+        }
+        for (int i = 0; i < SCORE_BUCKETS; ++i) {
+            total.scores[i] += data.scores[i].load(memory_order_relaxed);
+        }
+    }
+
+    static void WriteEvents(FILE* file, int id, const vector<TraceEvent>& events, bool& first) {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                first ? "" : ",\n", id, id);
+        first = false;
+        for (auto& event: events) {
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", event.name,
+                    id, event.start / 1e3, (event.end - event.start) / 1e3);
+        }
+    }
+
+    static atomic<bool>& TimingFlag() {
+        static atomic<bool> flag(false);
+        return flag;
+    }
+
+    static atomic<bool>& TracingFlag() {
+        static atomic<bool> flag(false);
+        return flag;
+    }
+
+    static chrono::steady_clock::time_point Epoch() {
+        static chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+        return epoch;
+    }
+};
+
+#define INSTRUMENT_CONCAT_(a, b) a##b
+#define INSTRUMENT_CONCAT(a, b) INSTRUMENT_CONCAT_(a, b)
+
+#ifndef CHENGSAN_NO_INSTRUMENT
+#define INSTRUMENT_COUNT(counter, n) Instrument::Count(Instrument::counter, n)
+#define INSTRUMENT_SCORE(winRate) Instrument::AddScore(winRate)
+#define INSTRUMENT_TIMER(timer) Instrument::ScopedTimer INSTRUMENT_CONCAT(instrumentTimer, __LINE__)(Instrument::timer)
+#define INSTRUMENT_TRACE(name) Instrument::ScopedTrace INSTRUMENT_CONCAT(instrumentTrace, __LINE__)(name)
+#else
+#define INSTRUMENT_COUNT(counter, n) ((void)0)
+#define INSTRUMENT_SCORE(winRate) ((void)0)
+#define INSTRUMENT_TIMER(timer) ((void)0)
+#define INSTRUMENT_TRACE(name) ((void)0)
+#endif
+
+#endif /* instrument_h */
@@ -6,10 +6,375 @@
 //  Copyright © 2016 maogm12@gmail.com. All rights reserved.
 //
 
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
 #include "game.h"
+#include "tablebase.h"
+#include "book.h"
+#include "arena.h"
+#include "bench.h"
+#include "perft.h"
+#include "ntuple.h"
+#include "service.h"
+#include "record.h"
 
-int main(int argc, const char * argv[]) {
-    Game game;
+// chengsan tablebase <file> [max pieces], solve the moving phase endgames into file
+static int GenerateTablebase(const vector<string>& args) {
+    if (args.size() < 2) {
+        fprintf(stderr, "Usage: chengsan tablebase <file> [max pieces]\n");
+        return 1;
+    }
+    int maxPieces = args.size() > 2 ? atoi(args[2].c_str()) : 4;
+    TablebaseGenerator generator(maxPieces, thread::hardware_concurrency());
+    generator.Generate(stdout);
+    uint64_t wrong = generator.Check(stdout);
+    if (wrong > 0) {
+        fprintf(stderr, "%llu boards disagree with their steps, not written\n", (unsigned long long)wrong);
+        return 2;
+    }
+    if (!generator.Write(args[1].c_str())) {
+        fprintf(stderr, "Cannot write %s\n", args[1].c_str());
+        return 1;
+    }
+    return 0;
+}
+
+// chengsan book <file> [plies [search depth]], build the placement phase opening book into file
+static int BuildBook(const vector<string>& args) {
+    if (args.size() < 2) {
+        fprintf(stderr, "Usage: chengsan book <file> [plies [search depth]]\n");
+        return 1;
+    }
+    int plies = args.size() > 2 ? atoi(args[2].c_str()) : 4;
+    int depth = args.size() > 3 ? atoi(args[3].c_str()) : 8;
+    BookBuilder builder(plies, SearchLimits::Depth(depth), thread::hardware_concurrency());
+    builder.Build(stdout);
+    if (!builder.Write(args[1].c_str())) {
+        fprintf(stderr, "Cannot write %s\n", args[1].c_str());
+        return 1;
+    }
+    return 0;
+}
+
+// chengsan arena <games> [ms per step [engine a [engine b [results file]]]], a headless match on every core
+static int RunArena(const vector<string>& args, uint64_t seed, int maxRounds, GameRecorder* recorder) {
+    if (args.size() < 2) {
+        fprintf(stderr, "Usage: chengsan arena <games> [ms per step [engine a [engine b [results file]]]]\n");
+        return 1;
+    }
+    size_t games = strtoull(args[1].c_str(), NULL, 10);
+    SearchLimits limits = SearchLimits::Millis(args.size() > 2 ? atoll(args[2].c_str()) : 100);
+    // the games run in parallel, so every engine searches on one thread
+    EngineConfig a(EngineConfig::MCTS, limits, 1), b(EngineConfig::MONTE_CARLO, limits, 1);
+    if ((args.size() > 3 && !EngineConfig::ParseType(args[3], a.type))
+        || (args.size() > 4 && !EngineConfig::ParseType(args[4], b.type))
+        || a.type == EngineConfig::HUMAN || b.type == EngineConfig::HUMAN) {
+        fprintf(stderr, "Arena engines are mc, mcts or ab\n");
+        return 1;
+    }
+
+    printf("Seed: %llu\n", (unsigned long long)seed);
+    Arena arena(a, b, seed, maxRounds);
+    arena.SetRecorder(recorder);
+    FILE* out = NULL;
+    if (args.size() > 5) {
+        const string& path = args[5];
+        out = fopen(path.c_str(), "w");
+        if (!out) {
+            fprintf(stderr, "Cannot write %s\n", path.c_str());
+            return 1;
+        }
+        bool jsonl = path.size() >= 6 && path.compare(path.size() - 6, 6, ".jsonl") == 0;
+        arena.SetOutput(out, jsonl ? Arena::JSONL : Arena::CSV);
+    }
+    ArenaResult result = arena.Run(games, thread::hardware_concurrency(), stdout);
+    if (out) {
+        fclose(out);
+    }
+    Arena::PrintSummary(result, a, b);
+    return 0;
+}
+
+/*
+ chengsan bench [compare <baseline.json>] [save <file.json>], fails when a benchmark regressed
+ chengsan bench smp [depth [max threads]], Lazy SMP time to depth at 1, 2, 4... threads
+ */
+static int RunBench(const vector<string>& args) {
+    if (args.size() > 1 && args[1] == "smp") {
+        int depth = args.size() > 2 ? atoi(args[2].c_str()) : 10;
+        size_t maxThreads = args.size() > 3 ? strtoull(args[3].c_str(), NULL, 10) : 32;
+        vector<size_t> threadCounts;
+        for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+            threadCounts.push_back(threads);
+        }
+        printf("Depth %d on %u cores\n", depth, thread::hardware_concurrency());
+        Bench().Scaling(depth, threadCounts);
+        return 0;
+    }
+
+    const char* baselinePath = NULL;
+    const char* savePath = NULL;
+    for (size_t i = 1; i + 1 < args.size(); i += 2) {
+        if (args[i] == "compare") {
+            baselinePath = args[i + 1].c_str();
+        } else if (args[i] == "save") {
+            savePath = args[i + 1].c_str();
+        }
+    }
+    map<string, double> baseline;
+    if (baselinePath && !Bench::Load(baselinePath, baseline)) {
+        fprintf(stderr, "Cannot read %s\n", baselinePath);
+        return 1;
+    }
+
+    Bench bench;
+    vector<BenchResult> results = bench.RunAll();
+    if (savePath && !Bench::Save(results, savePath)) {
+        fprintf(stderr, "Cannot write %s\n", savePath);
+        return 1;
+    }
+    if (baselinePath) {
+        printf("\nAgainst %s:\n", baselinePath);
+        return Bench::Compare(results, baseline) > 0 ? 2 : 0;
+    }
+    return 0;
+}
+
+// chengsan train <file> [games [alpha]], self-play TD training of the n-tuple network in file, continued if it exists
+static int TrainNetwork(const vector<string>& args, uint64_t seed) {
+    if (args.size() < 2) {
+        fprintf(stderr, "Usage: chengsan train <file> [games [alpha]]\n");
+        return 1;
+    }
+    uint64_t games = args.size() > 2 ? strtoull(args[2].c_str(), NULL, 10) : 100000;
+    float alpha = args.size() > 3 ? (float)atof(args[3].c_str()) : NTupleTrainer::DEFAULT_ALPHA;
+    NTupleNetwork network;
+    if (network.Open(args[1].c_str())) {
+        printf("Continuing from %llu games\n", (unsigned long long)network.Games());
+    }
+    NTupleTrainer trainer(network, seed, alpha);
+    trainer.Train(games, stdout);
+    if (!network.Write(args[1].c_str())) {
+        fprintf(stderr, "Cannot write %s\n", args[1].c_str());
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ chengsan perft <depth> [<board> <round> <player>] [divide] [hash] [check]
+ board is 24 characters of .12*, the start of the game by default. divide
+ prints the count below every first step, hash caches subtotals and check
+ compares every step list and every board after a step with the reference
+ generator.
+ */
+static int RunPerft(const vector<string>& args) {
+    if (args.size() < 2) {
+        fprintf(stderr, "Usage: chengsan perft <depth> [<board> <round> <player>] [divide] [hash] [check]\n");
+        return 1;
+    }
+    int depth = atoi(args[1].c_str()), round = 0, toMove = Board::FIRST_TAG;
+    bool divide = false, useHash = false, check = false;
+    Board board;
+    for (size_t i = 2; i < args.size(); ++i) {
+        if (args[i] == "divide") {
+            divide = true;
+        } else if (args[i] == "hash") {
+            useHash = true;
+        } else if (args[i] == "check") {
+            check = true;
+        } else if (i + 2 < args.size() && Board::FromString(args[i], board)) {
+            round = atoi(args[i + 1].c_str());
+            toMove = atoi(args[i + 2].c_str()) == Board::SECOND_TAG ? Board::SECOND_TAG : Board::FIRST_TAG;
+            i += 2;
+        } else {
+            fprintf(stderr, "Unknown perft argument: %s\n", args[i].c_str());
+            return 1;
+        }
+    }
+
+    Perft perft(useHash, check);
+    auto start = chrono::steady_clock::now();
+    uint64_t total = 0;
+    if (divide) {
+        for (auto& item: perft.Divide(board, toMove, round, depth)) {
+            const Step& step = item.first;
+            if (step.type == Step::MOVE) {
+                printf("%2u-%-2u", step.moveFrom, step.moveTo);
+            } else {
+                printf("%5u", step.placePos);
+            }
+            if (step.eatPos != Step::NONE_POS) {
+                printf(" x%-2u", step.eatPos);
+            } else {
+                printf("    ");
+            }
+            printf(": %llu\n", (unsigned long long)item.second);
+            total += item.second;
+        }
+    } else {
+        total = perft.Count(board, toMove, round, depth);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("perft(%d) = %llu, %llu boards generated in %.3f s, %.0f boards/s\n", depth, (unsigned long long)total,
+           (unsigned long long)perft.Nodes(), seconds, seconds > 0 ? perft.Nodes() / seconds : 0);
+    if (check) {
+        printf("%llu mismatches with the reference generator\n", (unsigned long long)perft.Mismatches());
+        return perft.Mismatches() ? 2 : 0;
+    }
+    return 0;
+}
+
+// chengsan serve [threads], the analysis service on stdin and stdout, see service.h for the protocol
+static int Serve(const vector<string>& args, uint64_t seed) {
+    size_t threads = args.size() > 1 ? strtoull(args[1].c_str(), NULL, 10) : thread::hardware_concurrency();
+    AnalysisService service(threads, seed);
+    service.Run(stdin);
+    return 0;
+}
+
+// chengsan records <file>..., what the recorded games of the files show
+static int AnalyseRecords(const vector<string>& args) {
+    if (args.size() < 2) {
+        fprintf(stderr, "Usage: chengsan records <file>...\n");
+        return 1;
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    RecordAnalysis::Totals totals = RecordAnalysis::Run(vector<string>(args.begin() + 1, args.end()),
+                                                        thread::hardware_concurrency());
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    RecordAnalysis::Print(totals, seconds);
+    return 0;
+}
+
+// Run the subcommand in args, or play a game
+static int Run(const vector<string>& args, uint64_t seed, int maxRounds, bool profile, bool ponder,
+               GameRecorder* recorder) {
+    if (!args.empty() && args[0] == "tablebase") {
+        return GenerateTablebase(args);
+    }
+    if (!args.empty() && args[0] == "book") {
+        return BuildBook(args);
+    }
+    if (!args.empty() && args[0] == "train") {
+        return TrainNetwork(args, seed);
+    }
+    if (!args.empty() && args[0] == "perft") {
+        return RunPerft(args);
+    }
+    if (!args.empty() && args[0] == "bench") {
+        return RunBench(args);
+    }
+    if (!args.empty() && args[0] == "records") {
+        return AnalyseRecords(args);
+    }
+    if (!args.empty() && args[0] == "serve") {
+        return Serve(args, seed);
+    }
+    if (!args.empty() && args[0] == "arena") {
+        return RunArena(args, seed, maxRounds, recorder);
+    }
+
+    // chengsan [seed [ms per step [1st engine [2nd engine]]]], engines are mc, mcts, ab or human
+    // pass the printed seed back to replay a game
+    if (args.size() > 0) {
+        seed = strtoull(args[0].c_str(), NULL, 10);
+    }
+    printf("Seed: %llu\n", (unsigned long long)seed);
+    SearchLimits limits;
+    if (args.size() > 1) {
+        limits = SearchLimits::Millis(atoll(args[1].c_str()));
+    }
+    EngineConfig configs[3];
+    for (int tag = Board::FIRST_TAG; tag <= Board::SECOND_TAG; ++tag) {
+        configs[tag] = EngineConfig(EngineConfig::MCTS, limits, thread::hardware_concurrency());
+        if (args.size() > (size_t)(1 + tag) && !EngineConfig::ParseType(args[1 + tag], configs[tag].type)) {
+            fprintf(stderr, "Unknown engine: %s\n", args[1 + tag].c_str());
+            return 1;
+        }
+    }
+    for (int tag = Board::FIRST_TAG; tag <= Board::SECOND_TAG; ++tag) {
+        // a human leaves the cores idle while thinking, so the engine against one always ponders
+        configs[tag].ponder = ponder || configs[Board::Opponent(tag)].type == EngineConfig::HUMAN;
+    }
+    Game game(seed, configs[Board::FIRST_TAG], configs[Board::SECOND_TAG]);
+    game.SetProfile(profile);
+    game.SetRecorder(recorder);
     game.Run();
     return 0;
 }
+
+int main(int argc, const char * argv[]) {
+    // options are --name=value and may go anywhere:
+    //   --tablebase=<file>    probe the endgame tablebase in file while searching
+    //   --book=<file>         play the placement phase from the opening book in file
+    //   --weights=<file>      evaluate with the n-tuple network in file instead of MCTS rollouts and static scores
+    //   --seed=<n>            seed of the game or match, the time by default
+    //   --max-rounds=<n>      arena games still going after n rounds are draws
+    //   --profile             time the searches and print what every step cost
+    //   --trace=<file>        write a Chrome trace of the searches to file at exit
+    //   --ponder              let MCTS engines search on the opponent's time too
+    //   --record=<file>       append every game played, alone or in the arena, to the game records in file
+    vector<string> args;
+    uint64_t seed = (uint64_t)time(NULL);
+    int maxRounds = Arena::DEFAULT_MAX_ROUNDS;
+    const char* tracePath = NULL;
+    bool profile = false, ponder = false;
+    Tablebase tablebase;
+    OpeningBook book;
+    NTupleNetwork network;
+    GameRecorder recorder;
+    GameRecorder* recording = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--tablebase=", 12) == 0) {
+            if (!tablebase.Open(argv[i] + 12)) {
+                fprintf(stderr, "Cannot open tablebase: %s\n", argv[i] + 12);
+                return 1;
+            }
+            Tablebase::Shared() = &tablebase;
+        } else if (strncmp(argv[i], "--book=", 7) == 0) {
+            if (!book.Open(argv[i] + 7)) {
+                fprintf(stderr, "Cannot open book: %s\n", argv[i] + 7);
+                return 1;
+            }
+            OpeningBook::Shared() = &book;
+        } else if (strncmp(argv[i], "--weights=", 10) == 0) {
+            if (!network.Open(argv[i] + 10)) {
+                fprintf(stderr, "Cannot open weights: %s\n", argv[i] + 10);
+                return 1;
+            }
+            NTupleNetwork::Shared() = &network;
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            seed = strtoull(argv[i] + 7, NULL, 10);
+        } else if (strncmp(argv[i], "--max-rounds=", 13) == 0) {
+            maxRounds = atoi(argv[i] + 13);
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            profile = true;
+            Instrument::SetTiming(true);
+        } else if (strcmp(argv[i], "--ponder") == 0) {
+            ponder = true;
+        } else if (strncmp(argv[i], "--record=", 9) == 0) {
+            if (!recorder.Open(argv[i] + 9)) {
+                fprintf(stderr, "Cannot write %s\n", argv[i] + 9);
+                return 1;
+            }
+            recording = &recorder;
+        } else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            tracePath = argv[i] + 8;
+            Instrument::SetTracing(true);
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    int status = Run(args, seed, maxRounds, profile, ponder, recording);
+    if (tracePath && !Instrument::WriteTrace(tracePath)) {
+        fprintf(stderr, "Cannot write %s\n", tracePath);
+        return 1;
+    }
+    return status;
+}
@@ -0,0 +1,425 @@
+//
+//  mcts.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef mcts_h
+#define mcts_h
+
+#include <cmath>
+#include <ctime>
+#include <vector>
+#include "board.h"
+#include "player.h"
+#include "rng.h"
+#include "search.h"
+#include "tablebase.h"
+#include "ntuple.h"
+#include "instrument.h"
+#include "utils.h"
+
+using namespace std;
+
+/*
+ UCT Monte Carlo tree search. Every iteration walks down the tree with UCB1,
+ expands the leaf it reaches, finishes the game with random steps and
+ propagates the result back up.
+
+ The nodes live in one pre-reserved vector and link to each other by index.
+ The children of a node are allocated together, so they are contiguous. Freeing
+ the tree is clearing the vector.
+
+ The tree outlives a search: its root moves down to the chosen step, and the
+ next search starts from the child of the opponent's reply, with all the
+ visits it already has. Ponder grows it on the opponent's time.
+ */
+class MctsPlayer {
+public:
+    static const size_t DEFAULT_CAPACITY = 1 << 20;
+    static const uint64_t DEFAULT_PLAYOUTS = 20000;     // used when a search has no limit
+    static const int MAX_ROLLOUT_STEPS = 200;
+
+    MctsPlayer(int selfTag, int oTag, uint64_t seed = (uint64_t)time(NULL), size_t capacity = DEFAULT_CAPACITY)
+    :tag(selfTag), opponentTag(oTag), seed(seed), capacity(capacity),
+    self(selfTag, oTag, seed), opponent(oTag, selfTag, seed), rootToMove(selfTag), rootRound(0), rootWinner(0),
+    reusedVisits(0) {
+        nodes.reserve(capacity);
+        spare.reserve(capacity);
+    }
+
+    int Tag() const {
+        return tag;
+    }
+
+    // Nodes in the tree
+    size_t NodeNumber() const {
+        return nodes.size();
+    }
+
+    // The step to play on board, the tree moves down to it
+    Step Search(const Board& board, int round, const SearchLimits& limits = SearchLimits(), SearchInfo* info = NULL) {
+        return Advance(Analyse(board, round, limits, info));
+    }
+
+    /*
+     The best step on board so far, after growing its tree until a limit or
+     cancel stops it. The root stays at board, so analysing the same board
+     again goes on with the tree. The score of info is the win rate of the
+     step in per mille.
+     */
+    Step Analyse(const Board& board, int round, const SearchLimits& limits = SearchLimits(), SearchInfo* info = NULL,
+                 const atomic<bool>* cancel = NULL) {
+        INSTRUMENT_TRACE("MCTS");
+        SearchClock clock(limits.Unlimited() ? SearchLimits::Playouts(DEFAULT_PLAYOUTS) : limits);
+        SearchInfo ignored;
+        SearchInfo& result = info ? *info : ignored;
+        if (!Reroot(board, tag, round)) {
+            Reset(board, tag, round);
+        }
+        if (!nodes[0].expanded && !Expand(0, board, tag, round)) {
+            Reset(board, tag, round);
+            Expand(0, board, tag, round);
+        }
+
+        // no steps leave nothing to choose, a single choice needs no search
+        if (nodes[0].childNumber == 0) {
+            clock.Finish(result, 0, nodes.size(), false);
+            return Step::MakePlaceStep(tag, Step::NONE_POS);
+        }
+        if (nodes[0].childNumber == 1) {
+            clock.Finish(result, 0, nodes.size(), false);
+            return nodes[1].step;
+        }
+
+        // the visits so far tell apart the searches of a board analysed again
+        Rng rng(Utils::Mix(seed, (uint64_t)round, nodes[0].visits));
+        uint64_t playouts = Grow(clock, cancel, rng);
+
+        // the most visited step is the most trusted one
+        clock.Finish(result, playouts, nodes.size(), clock.TimeUp() || (limits.maxNodes > 0 && nodes.size() >= limits.maxNodes));
+        const Node& root = nodes[0];
+        for (uint32_t c = root.firstChild; c < root.firstChild + root.childNumber; ++c) {
+            if (nodes[c].visits > 0) {
+                INSTRUMENT_SCORE(nodes[c].wins / nodes[c].visits);
+            }
+        }
+        uint32_t best = root.firstChild;
+        for (uint32_t c = root.firstChild; c < root.firstChild + root.childNumber; ++c) {
+            if (nodes[c].winner == tag) {
+                best = c;
+                break;
+            }
+            if (nodes[c].visits > nodes[best].visits) {
+                best = c;
+            }
+        }
+        result.score = nodes[best].winner == tag ? 1000
+            : (nodes[best].visits > 0 ? (int)(1000 * nodes[best].wins / nodes[best].visits) : 500);
+        return nodes[best].step;
+    }
+
+    /*
+     Keep growing the tree of the last search, from the board after its step,
+     until cancel is set. Runs on the opponent's time, so that the next Search
+     starts from the subtree of the opponent's actual step.
+     */
+    void Ponder(const atomic<bool>& cancel) {
+        if (nodes.empty() || rootWinner != 0) {
+            return;
+        }
+        INSTRUMENT_TRACE("MCTS ponder");
+        if (!nodes[0].expanded) {
+            Expand(0, rootBoard, rootToMove, rootRound);
+        }
+        Rng rng(Utils::Mix(seed, (uint64_t)rootRound, PONDER_STREAM));
+        Grow(SearchClock(SearchLimits()), &cancel, rng);
+    }
+
+    // Visits of the root when the last search started, what it got from the searches before
+    uint32_t ReusedVisits() const {
+        return reusedVisits;
+    }
+private:
+    static const uint32_t NONE = 0xffffffff;
+
+    struct Node {
+        Node(const Step& step, uint32_t parent)
+        :step(step), parent(parent), firstChild(NONE), childNumber(0), winner(-1), expanded(false),
+        visits(0), wins(0) {
+        }
+
+        Step step;
+        uint32_t parent;
+        uint32_t firstChild;    // children are nodes [firstChild, firstChild + childNumber)
+        uint16_t childNumber;
+        int8_t winner;          // the winner if step ends the game, 0 if it does not, -1 unknown yet
+        bool expanded;
+        uint32_t visits;
+        float wins;             // for the player who made step, a draw counts half
+    };
+
+    static const uint64_t PONDER_STREAM = 0x706f6e646572;
+
+    // A fresh tree with board as its root
+    void Reset(const Board& board, int toMove, int round) {
+        nodes.clear();
+        nodes.push_back(Node(Step::MakePlaceStep(Board::Opponent(toMove), Step::NONE_POS), NONE));
+        rootBoard = board;
+        rootToMove = toMove;
+        rootRound = round;
+        rootWinner = 0;
+        reusedVisits = 0;
+    }
+
+    /*
+     Make the node of board the root, when it is the root or one of its
+     children, and drop the rest of the tree. False when the tree does not
+     have board.
+     */
+    bool Reroot(const Board& board, int toMove, int round) {
+        if (nodes.empty()) {
+            return false;
+        }
+        if (rootToMove == toMove && rootRound == round && rootBoard == board) {
+            reusedVisits = nodes[0].visits;
+            return true;
+        }
+        if (rootToMove == toMove || Board::NextRound(rootToMove, rootRound) != round || !nodes[0].expanded) {
+            return false;
+        }
+        for (uint32_t c = nodes[0].firstChild; c < nodes[0].firstChild + nodes[0].childNumber; ++c) {
+            Board child = rootBoard;
+            child.DoStep(nodes[c].step, rootRound);
+            if (child == board) {
+                Compact(c);
+                rootBoard = board;
+                rootToMove = toMove;
+                rootRound = round;
+                rootWinner = 0;
+                reusedVisits = nodes[0].visits;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Make the child with step the root, returns step
+    Step Advance(const Step& step) {
+        const Node& root = nodes[0];
+        for (uint32_t c = root.firstChild; c < root.firstChild + root.childNumber; ++c) {
+            if (nodes[c].step == step) {
+                int winner = 0;
+                rootBoard.DoStep(step, rootRound);
+                rootBoard.IsOver(winner, rootRound);
+                rootWinner = winner;
+                rootRound = Board::NextRound(rootToMove, rootRound);
+                rootToMove = Board::Opponent(rootToMove);
+                Compact(c);
+                break;
+            }
+        }
+        return step;
+    }
+
+    // Keep only the subtree of node, copied breadth first so children stay contiguous
+    void Compact(uint32_t node) {
+        spare.clear();
+        spare.push_back(nodes[node]);
+        spare[0].parent = NONE;
+        for (uint32_t i = 0; i < spare.size(); ++i) {
+            if (!spare[i].expanded) {
+                continue;
+            }
+            uint32_t first = spare[i].firstChild;
+            spare[i].firstChild = (uint32_t)spare.size();
+            for (uint32_t c = first; c < first + spare[i].childNumber; ++c) {
+                spare.push_back(nodes[c]);
+                spare.back().parent = i;
+            }
+        }
+        nodes.swap(spare);
+    }
+
+    // Iterations from the root until clock is done or cancel is set, returns how many ran
+    uint64_t Grow(const SearchClock& clock, const atomic<bool>* cancel, Rng& rng) {
+        const NTupleNetwork* network = NTupleNetwork::Shared();
+        Board scratch = rootBoard;
+        vector<StepUndo> path;
+        path.reserve(MAX_ROLLOUT_STEPS);
+        uint64_t playouts = 0;
+        for (; !clock.Done(playouts, nodes.size()) && !(cancel && cancel->load(memory_order_relaxed)); ++playouts) {
+            uint32_t node = 0;
+            int toMove = rootToMove, r = rootRound, winner = 0;
+
+            // selection, expanding the first leaf that was visited before
+            while (true) {
+                Node& current = nodes[node];
+                if (current.winner > 0) {
+                    winner = current.winner;
+                    break;
+                }
+                if (!current.expanded) {
+                    if (current.visits == 0 || !Expand(node, scratch, toMove, r)) {
+                        break;
+                    }
+                }
+                if (nodes[node].childNumber == 0) {
+                    break;
+                }
+
+                node = Select(node, rng);
+                path.push_back(scratch.DoStep(nodes[node].step, r));
+                INSTRUMENT_COUNT(STEPS_APPLIED, 1);
+                if (nodes[node].winner < 0) {
+                    int w;
+                    nodes[node].winner = scratch.IsOver(w, r) ? w : 0;
+                    INSTRUMENT_COUNT(TERMINAL_CHECKS, 1);
+                }
+                r = Board::NextRound(toMove, r);
+                toMove = Board::Opponent(toMove);
+            }
+
+            // simulation, or the chance toMove wins by the network instead of a whole random game
+            float value = -1;
+            if (winner == 0) {
+                if (network) {
+                    value = network->Evaluate(scratch, toMove, r);
+                    INSTRUMENT_COUNT(EVALUATIONS, 1);
+                } else {
+                    winner = Rollout(scratch, toMove, r, rng);
+                }
+            }
+
+            // backpropagation
+            while (true) {
+                Node& current = nodes[node];
+                current.visits++;
+                if (value >= 0) {
+                    current.wins += current.step.playerTag == toMove ? value : 1 - value;
+                } else if (winner == current.step.playerTag) {
+                    current.wins += 1;
+                } else if (winner == 0) {
+                    current.wins += 0.5f;
+                }
+                if (current.parent == NONE) {
+                    break;
+                }
+                node = current.parent;
+            }
+
+            while (!path.empty()) {
+                scratch.UndoStep(path.back());
+                path.pop_back();
+            }
+        }
+        return playouts;
+    }
+
+    const Player& PlayerOf(int playerTag) const {
+        return playerTag == tag ? self : opponent;
+    }
+
+    // Add the children of node, false when the arena is full
+    bool Expand(uint32_t node, const Board& board, int toMove, int round) {
+        MoveList steps;
+        PlayerOf(toMove).FindPossibleSteps(board, round, steps);
+        if (nodes.size() + steps.size() > capacity) {
+            return false;
+        }
+
+        nodes[node].firstChild = (uint32_t)nodes.size();
+        nodes[node].childNumber = (uint16_t)steps.size();
+        nodes[node].expanded = true;
+        for (auto& step: steps) {
+            nodes.push_back(Node(step, node));
+        }
+        return true;
+    }
+
+    // UCB1, unvisited children first, in random order
+    uint32_t Select(uint32_t node, Rng& rng) const {
+        const Node& parent = nodes[node];
+        uint32_t unvisited = 0;
+        for (uint32_t c = parent.firstChild; c < parent.firstChild + parent.childNumber; ++c) {
+            unvisited += nodes[c].visits == 0;
+        }
+        if (unvisited > 0) {
+            uint32_t index = rng.Bounded(unvisited);
+            for (uint32_t c = parent.firstChild; ; ++c) {
+                if (nodes[c].visits == 0 && index-- == 0) {
+                    return c;
+                }
+            }
+        }
+
+        double logVisits = log((double)parent.visits);
+        double bestValue = -1;
+        uint32_t best = parent.firstChild;
+        for (uint32_t c = parent.firstChild; c < parent.firstChild + parent.childNumber; ++c) {
+            const Node& child = nodes[c];
+            double value = child.wins / child.visits + 1.41421356 * sqrt(logVisits / child.visits);
+            if (value > bestValue) {
+                bestValue = value;
+                best = c;
+            }
+        }
+        return best;
+    }
+
+    // Random steps until the game ends, returns the winner, 0 for a draw. The board is left as it was.
+    int Rollout(Board& board, int toMove, int round, Rng& rng) const {
+        INSTRUMENT_TIMER(ROLLOUT);
+        StepUndo history[MAX_ROLLOUT_STEPS];
+        size_t depth = 0;
+        int winner = -1;
+        const Tablebase* tablebase = Tablebase::Shared();
+        while (depth < MAX_ROLLOUT_STEPS) {
+            // the tablebase knows how the game ends from here
+            Tablebase::Result result;
+            int distance;
+            if (tablebase && tablebase->Probe(board, toMove, round, result, distance)) {
+                winner = result == Tablebase::WIN ? toMove : (result == Tablebase::LOSS ? Board::Opponent(toMove) : 0);
+                INSTRUMENT_COUNT(TABLEBASE_HITS, 1);
+                break;
+            }
+            if (PlayerOf(toMove).PlayRandom(board, round, rng, history[depth++], winner)) {
+                break;
+            }
+            winner = -1;
+            round = Board::NextRound(toMove, round);
+            toMove = Board::Opponent(toMove);
+        }
+
+        if (winner < 0) {
+            // cut off, the one with more pieces is ahead
+            int diff = board.PieceNumber(tag) - board.PieceNumber(opponentTag);
+            winner = diff > 0 ? tag : (diff < 0 ? opponentTag : 0);
+        }
+        INSTRUMENT_COUNT(PLAYOUTS, 1);
+        INSTRUMENT_COUNT(PLAYOUT_PLIES, depth);
+        INSTRUMENT_COUNT(STEPS_APPLIED, depth);
+        INSTRUMENT_COUNT(TERMINAL_CHECKS, depth);
+        while (depth > 0) {
+            board.UndoStep(history[--depth]);
+        }
+        return winner;
+    }
+
+    int tag;
+    int opponentTag;
+    uint64_t seed;
+    size_t capacity;
+    Player self, opponent;
+    vector<Node> nodes;
+    vector<Node> spare;     // where Compact copies the kept subtree to
+    Board rootBoard;        // the board of nodes[0]
+    int rootToMove;
+    int rootRound;
+    int rootWinner;         // the winner if the game ended at the root, else 0
+    uint32_t reusedVisits;
+};
+
+#endif /* mcts_h */
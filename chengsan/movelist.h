@@ -0,0 +1,75 @@
+//
+//  movelist.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef movelist_h
+#define movelist_h
+
+#include <cassert>
+#include <cstddef>
+#include "step.h"
+
+/*
+ A list of steps kept inline, for generating steps without touching the heap.
+ A move uses one of the 32 edges of the board and a placement one of the 24
+ positions, and eating picks one of at most 12 pieces, so MAX_STEPS steps are
+ always enough.
+ */
+class MoveList {
+public:
+    static const size_t MAX_STEPS = 32 * 12;
+
+    MoveList()
+    :count(0) {
+    }
+
+    void push_back(const Step& step) {
+        assert(count < MAX_STEPS);
+        steps[count++] = step;
+    }
+
+    void clear() {
+        count = 0;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    Step& operator[](size_t index) {
+        return steps[index];
+    }
+
+    const Step& operator[](size_t index) const {
+        return steps[index];
+    }
+
+    Step* begin() {
+        return steps;
+    }
+
+    Step* end() {
+        return steps + count;
+    }
+
+    const Step* begin() const {
+        return steps;
+    }
+
+    const Step* end() const {
+        return steps + count;
+    }
+private:
+    size_t count;
+    Step steps[MAX_STEPS];
+};
+
+#endif /* movelist_h */
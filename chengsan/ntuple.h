@@ -0,0 +1,337 @@
+//
+//  ntuple.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef ntuple_h
+#define ntuple_h
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "board.h"
+#include "rng.h"
+#include "symmetry.h"
+
+using namespace std;
+
+/*
+ N-tuple network: the chance the player to move wins, as the logistic of a sum
+ of weights looked up by the states of a few groups of points. A point is
+ empty, own, the opponent's or blocked, 2 bits, so a ring of 8 points indexes
+ a table of 4^8 weights.
+
+ The tuples are the rings (the outer and the inner ring share a table, they
+ are swapped by a symmetry), the sectors of 3 points of every ring around a
+ cross line, and a material table of the piece numbers by round and player to
+ move. Every ring and sector is looked up under the rotations, the mirror and
+ the ring swap that give a different image, so symmetric boards get the same
+ value and every game teaches all of their images: FEATURES lookups per board.
+
+ File layout: an NTupleHeader, then WEIGHT_NUMBER floats.
+ */
+struct NTupleHeader {
+    static constexpr const char* MAGIC = "CSNT0001";
+
+    char magic[8];
+    uint64_t weightNumber;
+    uint64_t games;         // self-play games the weights learned from
+};
+
+struct NTupleTables {
+    uint16_t spread[256];   // bit k of a ring byte moved to bit 2k
+
+    static constexpr NTupleTables Make() {
+        NTupleTables t = {};
+        for (int byte = 0; byte < 256; ++byte) {
+            for (int k = 0; k < 8; ++k) {
+                if (byte & (1 << k)) {
+                    t.spread[byte] |= (uint16_t)(1 << (2 * k));
+                }
+            }
+        }
+        return t;
+    }
+};
+
+class NTupleNetwork {
+public:
+    static const size_t RING_SIZE = 1 << 16;
+    static const size_t SECTOR_SIZE = 1 << 18;
+    static const int ROUND_BUCKETS = 11;        // rounds 0 to 9, then every later round
+    static const size_t MATERIAL_SIZE = 2 * ROUND_BUCKETS * 10 * 10;
+
+    // Offsets of the tables in the weights
+    static const size_t OUTER_RING = 0,
+                        MIDDLE_RING = OUTER_RING + RING_SIZE,
+                        SECTOR = MIDDLE_RING + RING_SIZE,
+                        MATERIAL = SECTOR + SECTOR_SIZE,
+                        WEIGHT_NUMBER = MATERIAL + MATERIAL_SIZE;
+
+    static const int FEATURES = 16 + 8 + 16 + 1;    // outer and inner rings, middle ring, sectors, material
+    static const int SCORE_SCALE = 200;             // alpha-beta score of a logit of 1
+    static const int MAX_SCORE = 20000;
+
+    typedef uint32_t Features[FEATURES];
+
+    static constexpr NTupleTables tables = NTupleTables::Make();
+
+    NTupleNetwork()
+    :weights(WEIGHT_NUMBER, 0.0f), games(0) {
+    }
+
+    // Network the engines evaluate with, NULL when none was opened
+    static const NTupleNetwork*& Shared() {
+        static const NTupleNetwork* shared = NULL;
+        return shared;
+    }
+
+    bool Open(const char* path) {
+        FILE* file = fopen(path, "rb");
+        if (!file) {
+            return false;
+        }
+        NTupleHeader header;
+        vector<float> read(WEIGHT_NUMBER);
+        bool ok = fread(&header, sizeof(header), 1, file) == 1
+            && memcmp(header.magic, NTupleHeader::MAGIC, 8) == 0 && header.weightNumber == WEIGHT_NUMBER
+            && fread(read.data(), sizeof(float), read.size(), file) == read.size();
+        fclose(file);
+        if (ok) {
+            weights.swap(read);
+            games = header.games;
+        }
+        return ok;
+    }
+
+    bool Write(const char* path) const {
+        FILE* file = fopen(path, "wb");
+        if (!file) {
+            return false;
+        }
+        NTupleHeader header;
+        memcpy(header.magic, NTupleHeader::MAGIC, 8);
+        header.weightNumber = WEIGHT_NUMBER;
+        header.games = games;
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+            && fwrite(weights.data(), sizeof(float), weights.size(), file) == weights.size();
+        return fclose(file) == 0 && ok;
+    }
+
+    uint64_t Games() const {
+        return games;
+    }
+
+    void AddGames(uint64_t n) {
+        games += n;
+    }
+
+    // The weights board looks up for toMove in round
+    static void Extract(const Board& board, int toMove, int round, Features& features) {
+        uint32_t own = board.FindPlayer(toMove).Mask(), other = board.FindPlayer(Board::Opponent(toMove)).Mask();
+        uint32_t block = board.FindBlock().Mask();
+        uint32_t low = own | block, high = other | block;
+
+        // ring indexes, as they are and mirrored
+        uint32_t rings[2][3];
+        const uint8_t* mirror = Symmetry::tables.rings[4];
+        for (int r = 0; r < 3; ++r) {
+            uint32_t l = (low >> (8 * r)) & 0xff, h = (high >> (8 * r)) & 0xff;
+            rings[0][r] = tables.spread[l] | tables.spread[h] << 1;
+            rings[1][r] = tables.spread[mirror[l]] | tables.spread[mirror[h]] << 1;
+        }
+
+        int n = 0;
+        for (int m = 0; m < 2; ++m) {
+            // a rotation by 90 degrees moves every point of a ring by 2
+            for (int shift = 0; shift < 16; shift += 4) {
+                features[n++] = (uint32_t)(OUTER_RING + Rotate(rings[m][0], shift));
+                features[n++] = (uint32_t)(OUTER_RING + Rotate(rings[m][2], shift));
+                features[n++] = (uint32_t)(MIDDLE_RING + Rotate(rings[m][1], shift));
+
+                // the sector of the cross line at point shift / 2 + 1 of the rings
+                uint32_t outer = Rotate(rings[m][0], shift) & 0x3f, middle = Rotate(rings[m][1], shift) & 0x3f;
+                uint32_t inner = Rotate(rings[m][2], shift) & 0x3f;
+                features[n++] = (uint32_t)(SECTOR + (outer | middle << 6 | inner << 12));
+                features[n++] = (uint32_t)(SECTOR + (inner | middle << 6 | outer << 12));
+            }
+        }
+        int bucket = min(round, ROUND_BUCKETS - 1);
+        features[n++] = (uint32_t)(MATERIAL + ((toMove == Board::SECOND_TAG) * ROUND_BUCKETS + bucket) * 100
+                                   + min(__builtin_popcount(own), 9) * 10 + min(__builtin_popcount(other), 9));
+    }
+
+    float Logit(const Features& features) const {
+        float sum = 0;
+        for (int i = 0; i < FEATURES; ++i) {
+            sum += weights[features[i]];
+        }
+        return sum;
+    }
+
+    // Chance that toMove wins board in round
+    float Evaluate(const Board& board, int toMove, int round) const {
+        Features features;
+        Extract(board, toMove, round, features);
+        return Sigmoid(Logit(features));
+    }
+
+    // Evaluate as an alpha-beta score for toMove, far from the scores of won games
+    int Score(const Board& board, int toMove, int round) const {
+        Features features;
+        Extract(board, toMove, round, features);
+        int score = (int)lrintf(Logit(features) * SCORE_SCALE);
+        return min(max(score, -MAX_SCORE), MAX_SCORE);
+    }
+
+    // Add delta to every weight of features, a step of the logistic loss gradient
+    void Update(const Features& features, float delta) {
+        for (int i = 0; i < FEATURES; ++i) {
+            weights[features[i]] += delta;
+        }
+    }
+
+    static float Sigmoid(float logit) {
+        return 1.0f / (1.0f + expf(-logit));
+    }
+private:
+    // Rotate a 16 bit ring index right by shift bits
+    static uint32_t Rotate(uint32_t index, int shift) {
+        return ((index >> shift) | (index << (16 - shift))) & 0xffff;
+    }
+
+    vector<float> weights;
+    uint64_t games;
+};
+
+constexpr NTupleTables NTupleNetwork::tables;
+const int NTupleNetwork::MAX_SCORE;
+
+/*
+ Learns the weights by self-play with TD(0). Both sides pick the step whose
+ board is worst for the opponent, a random one EXPLORE_PERCENT of the time, and after
+ every step the value of the board before it moves toward the best value
+ among its steps: 1 or 0 for a step that ends the game, else 1 minus the
+ opponent's value. A game still going after MAX_PLIES steps stops there.
+ */
+class NTupleTrainer {
+public:
+    static const int MAX_PLIES = 200;
+    static const uint64_t LOG_GAMES = 1000;
+    static const int TEST_GAMES = 200;
+    static const uint32_t EXPLORE_PERCENT = 10;
+    static constexpr float DEFAULT_ALPHA = 0.003f;
+
+    NTupleTrainer(NTupleNetwork& network, uint64_t seed, float alpha = DEFAULT_ALPHA)
+    :network(network), rng(seed), alpha(alpha) {
+    }
+
+    // Play games of self-play, learning from every step, progress goes to log when it is not NULL
+    void Train(uint64_t games, FILE* log = NULL) {
+        double error = 0;
+        uint64_t plies = 0;
+        for (uint64_t g = 1; g <= games; ++g) {
+            plies += PlayGame(error);
+            network.AddGames(1);
+            if (log && (g % LOG_GAMES == 0 || g == games)) {
+                uint64_t played = g % LOG_GAMES ? g % LOG_GAMES : LOG_GAMES;
+                fprintf(log, "games %llu: td error %.4f, %.1f plies a game, %.1f%% won against random steps\n",
+                        (unsigned long long)network.Games(), plies ? error / plies : 0.0, (double)plies / played,
+                        100 * WinRateAgainstRandom(TEST_GAMES));
+                fflush(log);
+                error = 0;
+                plies = 0;
+            }
+        }
+    }
+
+    // Share of games the greedy network wins against uniformly random steps, it plays first in half of them
+    double WinRateAgainstRandom(int games) {
+        int won = 0;
+        for (int g = 0; g < games; ++g) {
+            int networkTag = g % 2 ? Board::SECOND_TAG : Board::FIRST_TAG;
+            Board board;
+            int toMove = Board::FIRST_TAG, round = 0, winner = 0;
+            for (int ply = 0; ply < MAX_PLIES && winner == 0; ++ply) {
+                MoveList steps;
+                board.FindPossibleSteps(toMove, round, steps);
+                Step step = toMove == networkTag ? Best(board, toMove, round, steps, NULL)
+                                                 : steps[rng.Bounded((uint32_t)steps.size())];
+                board.DoStep(step, round);
+                if (!board.IsOver(winner, round)) {
+                    winner = 0;
+                }
+                round = Board::NextRound(toMove, round);
+                toMove = Board::Opponent(toMove);
+            }
+            won += winner == networkTag;
+        }
+        return (double)won / games;
+    }
+private:
+    // One game of self-play, adds the squared errors of its steps to error and returns its length
+    int PlayGame(double& error) {
+        Board board;
+        int toMove = Board::FIRST_TAG, round = 0, winner = 0, ply = 0;
+        NTupleNetwork::Features features;
+        for (; ply < MAX_PLIES && winner == 0; ++ply) {
+            MoveList steps;
+            board.FindPossibleSteps(toMove, round, steps);
+            float target;
+            Step step = Best(board, toMove, round, steps, &target);
+            if (rng.Bounded(100) < EXPLORE_PERCENT) {
+                step = steps[rng.Bounded((uint32_t)steps.size())];
+            }
+
+            NTupleNetwork::Extract(board, toMove, round, features);
+            float delta = target - NTupleNetwork::Sigmoid(network.Logit(features));
+            network.Update(features, alpha * delta);
+            error += delta * delta;
+
+            board.DoStep(step, round);
+            if (!board.IsOver(winner, round)) {
+                winner = 0;
+            }
+            round = Board::NextRound(toMove, round);
+            toMove = Board::Opponent(toMove);
+        }
+        return ply;
+    }
+
+    // The step of steps best for toMove by the network, its value goes to value. Ties go to a random one.
+    Step Best(Board& board, int toMove, int round, const MoveList& steps, float* value) {
+        size_t start = rng.Bounded((uint32_t)steps.size()), best = start;
+        float bestValue = -1;
+        for (size_t j = 0; j < steps.size(); ++j) {
+            size_t i = (start + j) % steps.size();
+            int winner;
+            float v;
+            StepUndo undo = board.DoStep(steps[i], round);
+            if (board.IsOver(winner, round)) {
+                v = winner == toMove ? 1.0f : 0.0f;
+            } else {
+                v = 1 - network.Evaluate(board, Board::Opponent(toMove), Board::NextRound(toMove, round));
+            }
+            board.UndoStep(undo);
+            if (v > bestValue) {
+                bestValue = v;
+                best = i;
+            }
+        }
+        if (value) {
+            *value = bestValue;
+        }
+        return steps[best];
+    }
+
+    NTupleNetwork& network;
+    Rng rng;
+    float alpha;
+};
+
+#endif /* ntuple_h */
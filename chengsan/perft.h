@@ -0,0 +1,280 @@
+//
+//  perft.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef perft_h
+#define perft_h
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <vector>
+#include "board.h"
+#include "movelist.h"
+
+using namespace std;
+
+/*
+ The step generator written the plain way, straight from the rules and the
+ SANS list: it walks positions one by one and tests every line by hand, with
+ none of the masks and tables Board uses. Its board is a plain array of tags
+ and it makes steps on it by itself, so the blocks going away in round 9 and
+ the eaten pieces are checked too. It is slow on purpose, perft checks
+ Board::FindPossibleSteps and Board::DoStep against it.
+ */
+class ReferenceGenerator {
+public:
+    typedef array<int, 24> Position;    // the tag of every position
+
+    static Position FromBoard(const Board& board) {
+        Position position;
+        for (size_t pos = 0; pos < 24; ++pos) {
+            position[pos] = board.At(pos);
+        }
+        return position;
+    }
+
+    static vector<Step> FindPossibleSteps(const Position& position, int playerTag, int round) {
+        vector<Step> steps;
+        int opponentTag = Board::Opponent(playerTag);
+        if (round < 9) {
+            for (size_t pos = 0; pos < 24; ++pos) {
+                if (position[pos] == Board::EMPTY_TAG) {
+                    Add(steps, Step::MakePlaceStep(playerTag, pos), position, opponentTag,
+                        MakesSan(position, playerTag, pos, Step::NONE_POS));
+                }
+            }
+            return steps;
+        }
+
+        for (size_t from = 0; from < 24; ++from) {
+            if (position[from] != playerTag) {
+                continue;
+            }
+            for (size_t to = 0; to < 24; ++to) {
+                if (position[to] == Board::EMPTY_TAG && AreNeighbours(from, to)) {
+                    Add(steps, Step::MakeMoveStep(playerTag, from, to), position, opponentTag,
+                        MakesSan(position, playerTag, to, from));
+                }
+            }
+        }
+        return steps;
+    }
+
+    // Make step of round on position: the blocks go when round 9 starts, eaten pieces leave a block while placing
+    static void DoStep(Position& position, const Step& step, int round) {
+        if (round == 9) {
+            for (auto& tag: position) {
+                if (tag == Board::BLOCK_TAG) {
+                    tag = Board::EMPTY_TAG;
+                }
+            }
+        }
+        if (step.type == Step::PLACE) {
+            position[step.placePos] = step.playerTag;
+        } else {
+            position[step.moveTo] = step.playerTag;
+            position[step.moveFrom] = Board::EMPTY_TAG;
+        }
+        if (step.eatPos != Step::NONE_POS) {
+            position[step.eatPos] = step.type == Step::PLACE ? Board::BLOCK_TAG : Board::EMPTY_TAG;
+        }
+    }
+private:
+    static void Add(vector<Step>& steps, Step step, const Position& position, int opponentTag, bool eats) {
+        if (!eats) {
+            steps.push_back(step);
+            return;
+        }
+        vector<size_t> free, all;
+        for (size_t pos = 0; pos < 24; ++pos) {
+            if (position[pos] == opponentTag) {
+                all.push_back(pos);
+                if (!InFullSan(position, opponentTag, pos)) {
+                    free.push_back(pos);
+                }
+            }
+        }
+        for (size_t pos: free.empty() ? all : free) {
+            step.eatPos = (uint32_t)pos;
+            steps.push_back(step);
+        }
+    }
+
+    static bool AreNeighbours(size_t a, size_t b) {
+        for (auto& san: BoardTables::SANS) {
+            for (size_t i = 0; i + 1 < 3; ++i) {
+                if ((san[i] == a && san[i + 1] == b) || (san[i] == b && san[i + 1] == a)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // playerTag fills a line through pos by putting a piece there, taken from from unless it is NONE_POS
+    static bool MakesSan(const Position& position, int playerTag, size_t pos, size_t from) {
+        for (auto& san: BoardTables::SANS) {
+            if (san[0] != pos && san[1] != pos && san[2] != pos) {
+                continue;
+            }
+            bool full = true;
+            for (size_t p: san) {
+                full = full && (p == pos || (p != from && position[p] == playerTag));
+            }
+            if (full) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool InFullSan(const Position& position, int playerTag, size_t pos) {
+        for (auto& san: BoardTables::SANS) {
+            if ((san[0] == pos || san[1] == pos || san[2] == pos) && position[san[0]] == playerTag
+                && position[san[1]] == playerTag && position[san[2]] == playerTag) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/*
+ Counts the step sequences of a given length from a board, the standard way
+ to measure and verify a step generator. A step that ends the game ends its
+ sequence too and counts as one leaf. Subtotals can be cached by the board
+ hash, and every generated step list and every board after a step can be
+ checked against ReferenceGenerator.
+ */
+class Perft {
+public:
+    Perft(bool useHash = false, bool check = false, size_t hashEntries = 1 << 20)
+    :check(check), mismatches(0), nodes(0) {
+        if (useHash) {
+            table.resize(hashEntries);
+        }
+    }
+
+    uint64_t Count(Board board, int toMove, int round, int depth) {
+        ReferenceGenerator::Position reference = ReferenceGenerator::FromBoard(board);
+        return Search(board, reference, toMove, round, depth);
+    }
+
+    // The count below every root step
+    vector<pair<Step, uint64_t>> Divide(Board board, int toMove, int round, int depth) {
+        vector<pair<Step, uint64_t>> res;
+        MoveList steps;
+        board.FindPossibleSteps(toMove, round, steps);
+        for (auto& step: steps) {
+            int winner;
+            ReferenceGenerator::Position reference = ReferenceGenerator::FromBoard(board);
+            StepUndo undo = board.DoStep(step, round);
+            if (check) {
+                CheckStep(board, reference, step, round);
+            }
+            uint64_t count = depth <= 1 || board.IsOver(winner, round)
+                ? 1 : Search(board, reference, Board::Opponent(toMove), Board::NextRound(toMove, round), depth - 1);
+            board.UndoStep(undo);
+            res.push_back(make_pair(step, count));
+        }
+        return res;
+    }
+
+    // Boards where the generators, or the boards after a step, disagreed
+    uint64_t Mismatches() const {
+        return mismatches;
+    }
+
+    // Boards whose steps were generated
+    uint64_t Nodes() const {
+        return nodes;
+    }
+private:
+    struct Entry {
+        uint64_t key;
+        uint64_t count;     // 0 for an empty entry
+        int depth;
+    };
+
+    // reference is board as ReferenceGenerator keeps it, only followed when checking
+    uint64_t Search(Board& board, const ReferenceGenerator::Position& reference, int toMove, int round, int depth) {
+        if (depth == 0) {
+            return 1;
+        }
+        uint64_t key = board.Hash(toMove, round);
+        Entry* entry = table.empty() ? NULL : &table[(key ^ (uint64_t)depth * 0x9e3779b97f4a7c15ULL) % table.size()];
+        if (entry && entry->count && entry->key == key && entry->depth == depth) {
+            return entry->count;
+        }
+
+        MoveList steps;
+        board.FindPossibleSteps(toMove, round, steps);
+        nodes++;
+        if (check) {
+            Check(board, reference, toMove, round, steps);
+        }
+
+        uint64_t total = 0;
+        if (depth == 1) {
+            // the leaves are the steps themselves, over or not
+            total = steps.size();
+        } else {
+            for (auto& step: steps) {
+                int winner;
+                ReferenceGenerator::Position next = reference;
+                StepUndo undo = board.DoStep(step, round);
+                if (check) {
+                    CheckStep(board, next, step, round);
+                }
+                total += board.IsOver(winner, round)
+                    ? 1 : Search(board, next, Board::Opponent(toMove), Board::NextRound(toMove, round), depth - 1);
+                board.UndoStep(undo);
+            }
+        }
+
+        if (entry) {
+            *entry = Entry{key, total, depth};
+        }
+        return total;
+    }
+
+    void Check(const Board& board, const ReferenceGenerator::Position& position, int toMove, int round,
+               const MoveList& steps) {
+        vector<uint32_t> fast, reference;
+        for (auto& step: steps) {
+            fast.push_back(step.bits);
+        }
+        for (auto& step: ReferenceGenerator::FindPossibleSteps(position, toMove, round)) {
+            reference.push_back(step.bits);
+        }
+        sort(fast.begin(), fast.end());
+        sort(reference.begin(), reference.end());
+        if (fast != reference) {
+            if (mismatches++ < 10) {
+                fprintf(stderr, "Mismatch on %s, player %d, round %d: %zu steps, reference %zu\n",
+                        board.ToString().c_str(), toMove, round, fast.size(), reference.size());
+            }
+        }
+    }
+
+    // Make step on the reference too, board has made it already
+    void CheckStep(const Board& board, ReferenceGenerator::Position& reference, const Step& step, int round) {
+        ReferenceGenerator::DoStep(reference, step, round);
+        if (reference != ReferenceGenerator::FromBoard(board) && mismatches++ < 10) {
+            fprintf(stderr, "Mismatch after %s in round %d: %s\n", step.ToString().c_str(), round,
+                    board.ToString().c_str());
+        }
+    }
+
+    bool check;
+    uint64_t mismatches;
+    uint64_t nodes;
+    vector<Entry> table;
+};
+
+#endif /* perft_h */
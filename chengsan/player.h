@@ -9,17 +9,24 @@
 #ifndef player_h
 #define player_h
 
+#include <algorithm>
 #include <iostream>
 #include <cstdlib>
 #include <ctime>
+#include <cassert>
+#include <atomic>
+#include <memory>
 #include "utils.h"
 #include "step.h"
+#include "threadpool.h"
+#include "search.h"
+#include "instrument.h"
+#include "batchplayout.h"
 
 class Player {
 public:
-    Player(int selfTag, int oTag)
-    :tag(selfTag), opponentTag(oTag), ai(false) {
-        srand((unsigned)time(NULL));
+    Player(int selfTag, int oTag, uint64_t seed = (uint64_t)time(NULL))
+    :tag(selfTag), opponentTag(oTag), ai(false), seed(seed) {
     }
 
     bool IsAI() const {
@@ -38,114 +45,249 @@ public:
         return opponentTag;
     }
 
-    Step Random(const Board& board, int round) const {
+    uint64_t Seed() const {
+        return seed;
+    }
+
+    void SetSeed(uint64_t s) {
+        seed = s;
+    }
+
+    // Number of threads MonteCarlo runs its playouts on, 1 runs them on the caller
+    size_t Threads() const {
+        return pool ? pool->Size() : 1;
+    }
+
+    void SetThreads(size_t threads) {
+        pool.reset(threads > 1 ? new ThreadPool(threads) : nullptr);
+    }
+
+    // A uniformly random step (and a uniformly random piece to eat), without allocating
+    Step Random(const Board& board, int round, Rng& rng) const {
         if (round < 9) {
             // place
-            auto positions = board.FindEmpty();
-            auto pos = Utils::random(positions);
+            auto pos = rng.PickBit(board.FindEmpty().Mask());
             if (board.CanMakeSan(tag, pos)) {
                 // random eat a piece
-                auto eatPositions = board.FindToEat(opponentTag);
-                return Step::MakePlaceStep(tag, pos, Utils::random(eatPositions));
+                return Step::MakePlaceStep(tag, pos, rng.PickBit(board.FindToEat(opponentTag).Mask()));
             } else {
                 return Step::MakePlaceStep(tag, pos);
             }
         } else {
-            // move
-            auto steps = board.FindMoveSteps(tag);
-            auto chosen = Utils::random(steps);
-            if (board.CanMakeSan(tag, chosen.moveTo, chosen.moveFrom)) {
-                // random eat a piece
-                auto eatPositions = board.FindToEat(opponentTag);
-                chosen.eatPos = Utils::random<size_t>(0, eatPositions.size() - 1);
+            // move, count the steps first and then walk to the chosen one
+            uint32_t empty = board.FindEmpty().Mask();
+            uint32_t total = board.CountMoveSteps(tag);
+
+            // the game is over once a player can not move, so there is always a step
+            assert(total > 0);
+            uint32_t index = rng.Bounded(total);
+            for (auto from: board.FindPlayer(tag)) {
+                PosSet tos(Board::tables.nexts[from] & empty);
+                if (index >= tos.size()) {
+                    index -= tos.size();
+                    continue;
+                }
+
+                auto chosen = Step::MakeMoveStep(tag, from, tos.Nth(index));
+                if (board.CanMakeSan(tag, chosen.moveTo, chosen.moveFrom)) {
+                    // random eat a piece
+                    chosen.eatPos = rng.PickBit(board.FindToEat(opponentTag).Mask());
+                }
+                return chosen;
             }
-            return chosen;
+            return Step::MakeMoveStep(tag, Step::NONE_POS, Step::NONE_POS);
         }
     }
     
-    Step MonteCarlo(const Board& board, int round, const Player& oppenent, bool isFirst) const {
-        vector<Step> possibleSteps;
-        if (round < 9) {
-            for (auto pos: board.FindEmpty()) {
-                if (!board.CanMakeSan(tag, pos)) {
-                    possibleSteps.push_back(Step::MakePlaceStep(tag, pos));
-                    continue;
-                }
-                
-                for (auto eatPos: board.FindToEat(opponentTag)) {
-                    possibleSteps.push_back(Step::MakePlaceStep(tag, pos, eatPos));
-                }
+    void FindPossibleSteps(const Board& board, int round, MoveList& steps) const {
+        INSTRUMENT_TIMER(MOVE_GENERATION);
+        board.FindPossibleSteps(tag, round, steps);
+        INSTRUMENT_COUNT(STEP_LISTS, 1);
+        INSTRUMENT_COUNT(STEPS_GENERATED, steps.size());
+    }
+
+    // Do a random step on board, its undo goes to undo. True if it ends the game.
+    bool PlayRandom(Board& board, int round, Rng& rng, StepUndo& undo, int& winner) const {
+        Step step;
+        {
+            INSTRUMENT_TIMER(MOVE_GENERATION);
+            step = Random(board, round, rng);
+        }
+        {
+            INSTRUMENT_TIMER(STEP_APPLICATION);
+            undo = board.DoStep(step, round);
+        }
+        INSTRUMENT_TIMER(TERMINAL_CHECK);
+        return board.IsOver(winner, round);
+    }
+
+    // Play one random game on board, which is left as it was. Returns 1 if this player wins.
+    int Playout(Board& board, int round, const Player& oppenent, bool isFirst, Rng& rng, uint64_t* steps = NULL) const {
+        INSTRUMENT_TIMER(ROLLOUT);
+        // a playout is at most 100 rounds of 2 steps each
+        StepUndo history[200];
+        size_t depth = 0;
+        int winner, score = -1;
+        for (int j = 0; j < 100 && score < 0; ++j) {
+            if (oppenent.PlayRandom(board, round, rng, history[depth++], winner)) {
+                score = winner == tag;
+                break;
             }
-        } else {
-            for (auto step: board.FindMoveSteps(tag)) {
-                if (!board.CanMakeSan(tag, step.moveTo, step.moveFrom)) {
-                    possibleSteps.push_back(step);
-                    continue;
-                }
-                
-                for (auto eatPos: board.FindToEat(opponentTag)) {
-                    Step s = step; s.eatPos = eatPos;
-                    possibleSteps.push_back(s);
-                }
+            
+            if (isFirst) round++;
+            if (PlayRandom(board, round, rng, history[depth++], winner)) {
+                score = winner == tag;
+                break;
             }
+            if (!isFirst) round++;
         }
-        
-        vector<int> score(possibleSteps.size(), 0);
+        INSTRUMENT_COUNT(PLAYOUTS, 1);
+        INSTRUMENT_COUNT(PLAYOUT_PLIES, depth);
+        INSTRUMENT_COUNT(STEPS_APPLIED, depth);
+        INSTRUMENT_COUNT(TERMINAL_CHECKS, depth);
+        if (score < 0) {
+            score = board.PieceNumber(tag) > board.PieceNumber(opponentTag);
+        }
+        if (steps) {
+            *steps += depth;
+        }
+        while (depth > 0) {
+            board.UndoStep(history[--depth]);
+        }
+        return score;
+    }
+
+    /*
+     Score every possible step with up to 100 random playouts. The playouts are cut
+     into tasks of PLAYOUT_CHUNK playouts, each seeded from (seed, round, step, chunk),
+     so the result only depends on the seed, no matter how many threads run the tasks.
+     The tasks run in passes giving every step one more chunk. The last pass under a
+     playout limit splits what is left evenly, from a step picked by the seed, so when
+     a limit stops the search all steps have had about the same number of playouts.
+     */
+    Step MonteCarlo(const Board& board, int round, const Player& oppenent, bool isFirst,
+                    const SearchLimits& limits = SearchLimits(), SearchInfo* info = NULL) const {
+        static const int PLAYOUTS = 100, PLAYOUT_CHUNK = 10;
+
+        SearchClock clock(limits);
+        SearchInfo ignored;
+        SearchInfo& result = info ? *info : ignored;
+
+        INSTRUMENT_TRACE("MonteCarlo");
+        MoveList possibleSteps;
+        FindPossibleSteps(board, round, possibleSteps);
+        INSTRUMENT_COUNT(CANDIDATES, possibleSteps.size());
+        if (possibleSteps.empty()) {
+            clock.Finish(result, 0, 0, false);
+            return Step::MakePlaceStep(tag, Step::NONE_POS);
+        }
+        vector<bool> lost(possibleSteps.size(), false);
         int winner;
+        Board fakeBoard = board;
         for (int i = 0; i < possibleSteps.size(); ++i) {
-            Board fakeBoard = board;
-            int fakeRound = round;
-            fakeBoard.ApplyStep(possibleSteps[i], fakeRound);
-            if (fakeBoard.IsOver(winner, fakeRound)) {
+            StepUndo candidate = fakeBoard.DoStep(possibleSteps[i], round);
+            bool over = fakeBoard.IsOver(winner, round);
+            fakeBoard.UndoStep(candidate);
+            INSTRUMENT_COUNT(STEPS_APPLIED, 1);
+            INSTRUMENT_COUNT(TERMINAL_CHECKS, 1);
+            if (over) {
                 if (winner == tag) {
+                    INSTRUMENT_COUNT(EARLY_RETURNS, 1);
+                    clock.Finish(result, 0, i + 1, false);
                     return possibleSteps[i];
-                } else {
-                    continue;
                 }
+                lost[i] = true;
+                INSTRUMENT_COUNT(LOSING_CANDIDATES, 1);
             }
-            if (!isFirst) fakeRound++;
-            
-            Board backupBoard = fakeBoard;
-            int backupRound = fakeRound;
-            for (int k = 0; k < 100; ++k) {
-                bool over = false;
-                for (int j = 0; j < 100; ++j) {
-                    fakeBoard.ApplyStep(oppenent.Random(fakeBoard, fakeRound), fakeRound);
-                    if (fakeBoard.IsOver(winner, fakeRound)) {
-                        if (winner == tag) {
-                            score[i]++;
-                        }
-                        over = true;
-                        break;
-                    }
-                    
-                    if (isFirst) fakeRound++;
-                    fakeBoard.ApplyStep(Random(fakeBoard, fakeRound), fakeRound);
-                    if (fakeBoard.IsOver(winner, fakeRound)) {
-                        if (winner == tag) {
-                            score[i]++;
-                        }
-                        over = true;
-                        break;
-                    }
+        }
+
+        vector<int> score(possibleSteps.size(), 0), played(possibleSteps.size(), 0);
+        uint64_t playouts = 0, nodes = possibleSteps.size();
+        atomic<bool> stop(false);
+        for (int k = 0; k < PLAYOUTS && !stop; k += PLAYOUT_CHUNK) {
+            vector<int> tasks;
+            for (size_t i = 0; i < possibleSteps.size(); ++i) {
+                if (!lost[i]) {
+                    tasks.push_back((int)i);
                 }
-                if (!over) {
-                    if (fakeBoard.PieceNumber(tag) > fakeBoard.PieceNumber(opponentTag)) {
-                        score[i]++;
-                    }
+            }
+            if (tasks.empty()) {
+                break;
+            }
+            vector<int> chunks(tasks.size(), PLAYOUT_CHUNK);
+            if (limits.maxPlayouts > 0 && limits.maxPlayouts - playouts < (uint64_t)tasks.size() * PLAYOUT_CHUNK) {
+                // the remainder goes to the steps from a seeded start, not always to the first ones
+                uint64_t left = limits.maxPlayouts - playouts;
+                rotate(tasks.begin(), tasks.begin() + Utils::Mix(seed, (uint64_t)round, (uint64_t)k) % tasks.size(),
+                       tasks.end());
+                for (size_t t = 0; t < tasks.size(); ++t) {
+                    chunks[t] = (int)(left / tasks.size() + (t < left % tasks.size()));
+                }
+                tasks.resize(min<uint64_t>(tasks.size(), left));
+                if (tasks.empty()) {
+                    break;
+                }
+            }
+
+            vector<int> taskScore(tasks.size(), 0), taskPlayed(tasks.size(), 0);
+            vector<uint64_t> taskSteps(tasks.size(), 0);
+            auto runTask = [&](size_t t) {
+                INSTRUMENT_TRACE("MonteCarlo playouts");
+                int i = tasks[t];
+                if (stop || clock.TimeUp()) {
+                    stop = true;
+                    return;
+                }
+                Board scratch = board;
+                int fakeRound = round;
+                scratch.DoStep(possibleSteps[i], fakeRound);
+                if (!isFirst) fakeRound++;
+                // a chunk is a batch of vectorized playouts, they take the same random steps as Playout
+                taskScore[t] = BatchPlayout::Wins(scratch, oppenent.Tag(), fakeRound, tag, chunks[t],
+                                                  Utils::Mix(seed, (uint64_t)round, (uint64_t)i, (uint64_t)k),
+                                                  &taskSteps[t]);
+                taskPlayed[t] = chunks[t];
+            };
+            if (pool) {
+                for (size_t t = 0; t < tasks.size(); ++t) {
+                    pool->Submit([&runTask, t](size_t) {
+                        runTask(t);
+                    });
                 }
-                fakeBoard = backupBoard;
-                fakeRound = backupRound;
+                pool->Wait();
+            } else {
+                for (size_t t = 0; t < tasks.size(); ++t) {
+                    runTask(t);
+                }
+            }
+
+            for (size_t t = 0; t < tasks.size(); ++t) {
+                score[tasks[t]] += taskScore[t];
+                played[tasks[t]] += taskPlayed[t];
+                playouts += taskPlayed[t];
+                nodes += taskSteps[t];
+            }
+            if (clock.Done(playouts, nodes)) {
+                stop = true;
             }
         }
         
-        int maxScore = -1, maxPos = -1;
-        for (int i = 0; i < score.size(); ++i) {
-            if (score[i] > maxScore) {
-                maxScore = score[i];
+        // best win rate so far, steps that lose at once or never got a playout come last
+        size_t maxPos = 0;
+        while (maxPos + 1 < possibleSteps.size() && lost[maxPos]) {
+            maxPos++;
+        }
+        for (size_t i = 0; i < score.size(); ++i) {
+            if (played[i] > 0) {
+                INSTRUMENT_SCORE((double)score[i] / played[i]);
+            }
+        }
+        for (size_t i = 1; i < score.size(); ++i) {
+            if (played[i] > 0 && (played[maxPos] == 0 || (int64_t)score[i] * played[maxPos] > (int64_t)score[maxPos] * played[i])) {
                 maxPos = i;
             }
         }
+        clock.Finish(result, playouts, nodes, stop);
         return possibleSteps[maxPos];
     }
     
@@ -212,6 +354,8 @@ private:
     bool ai;
     int tag;
     int opponentTag;
+    uint64_t seed;
+    unique_ptr<ThreadPool> pool;
 };
 
 #endif /* player_h */
@@ -0,0 +1,96 @@
+//
+//  posset.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef posset_h
+#define posset_h
+
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+/*
+ A set of board positions stored as a 24-bit mask, bit i stands for position i.
+ It can be iterated like the unordered_set<size_t> it replaces, walking the set
+ bits from the lowest one.
+ */
+class PosSet {
+public:
+    static const uint32_t ALL = 0xffffff;
+
+    class iterator {
+    public:
+        explicit iterator(uint32_t bits)
+        :bits(bits) {
+        }
+
+        size_t operator*() const {
+            return (size_t)__builtin_ctz(bits);
+        }
+
+        iterator& operator++() {
+            bits &= bits - 1;
+            return *this;
+        }
+
+        bool operator!=(const iterator& other) const {
+            return bits != other.bits;
+        }
+
+        bool operator==(const iterator& other) const {
+            return bits == other.bits;
+        }
+    private:
+        uint32_t bits;
+    };
+
+    PosSet(uint32_t mask = 0)
+    :mask(mask) {
+    }
+
+    static uint32_t Bit(size_t pos) {
+        return 1u << pos;
+    }
+
+    uint32_t Mask() const {
+        return mask;
+    }
+
+    iterator begin() const {
+        return iterator(mask);
+    }
+
+    iterator end() const {
+        return iterator(0);
+    }
+
+    size_t size() const {
+        return (size_t)__builtin_popcount(mask);
+    }
+
+    bool empty() const {
+        return mask == 0;
+    }
+
+    size_t count(size_t pos) const {
+        return (mask >> pos) & 1;
+    }
+
+    // The index-th lowest position in the set, index must be less than size()
+    size_t Nth(size_t index) const {
+        uint32_t bits = mask;
+        for (; index > 0; --index) {
+            bits &= bits - 1;
+        }
+        return (size_t)__builtin_ctz(bits);
+    }
+private:
+    uint32_t mask;
+};
+
+#endif /* posset_h */
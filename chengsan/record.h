@@ -0,0 +1,537 @@
+//
+//  record.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef record_h
+#define record_h
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "board.h"
+#include "engine.h"
+#include "symmetry.h"
+#include "threadpool.h"
+
+using namespace std;
+
+/*
+ Binary game records. A file is any number of games one after the other, so
+ games are appended to it and files are joined with cat. A game is a
+ GameRecordHeader, then a RecordPly per step, the first player's steps at
+ even plies, then an end ply with Step::NONE_CODE as its move and the winner,
+ 0 for a draw, as its latency. The header has the number of steps, so the end
+ ply sits where the header says. A game cut off before it, say by a crash, is
+ incomplete, and the reader finds the next game by its magic, so games appended
+ after the crash or joined with cat behind it still read.
+
+ Everything is little endian as the machine writes it, the header is 104
+ bytes and a step 4, so a game of 60 steps takes 348 bytes.
+ */
+struct RecordEngine {
+    uint8_t type;           // EngineConfig::Type
+    uint8_t ponder;
+    uint16_t threads;
+    int32_t maxDepth;
+    int64_t maxMillis;
+    uint64_t maxPlayouts;
+    uint64_t maxNodes;
+    uint64_t solverNodes;
+};
+
+struct GameRecordHeader {
+    static constexpr const char* MAGIC = "CSGR0002";
+
+    static GameRecordHeader Make(uint64_t seed, const EngineConfig& first, const EngineConfig& second, int maxRounds,
+                                 size_t plyNumber) {
+        GameRecordHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, MAGIC, 8);
+        header.seed = seed;
+        const EngineConfig* configs[2] = {&first, &second};
+        for (int i = 0; i < 2; ++i) {
+            const EngineConfig& config = *configs[i];
+            RecordEngine& engine = header.engines[i];
+            engine.type = (uint8_t)config.type;
+            engine.ponder = config.ponder;
+            engine.threads = (uint16_t)min(config.threads, (size_t)0xffff);
+            engine.maxDepth = config.limits.maxDepth;
+            engine.maxMillis = config.limits.maxMillis;
+            engine.maxPlayouts = config.limits.maxPlayouts;
+            engine.maxNodes = config.limits.maxNodes;
+            engine.solverNodes = config.solverNodes;
+        }
+        header.maxRounds = maxRounds;
+        header.plyNumber = (uint32_t)plyNumber;
+        return header;
+    }
+
+    char magic[8];
+    uint64_t seed;              // of the Game
+    RecordEngine engines[2];    // of the first and the second player
+    int32_t maxRounds;
+    uint32_t plyNumber;         // steps before the end ply
+};
+
+struct RecordPly {
+    static const uint16_t MAX_MICROS = 0x7fff;
+
+    // Micros up to MAX_MICROS as they are, millis above with the high bit set, up to 32.7 s
+    static uint16_t PackLatency(int64_t micros) {
+        if (micros <= MAX_MICROS) {
+            return (uint16_t)max<int64_t>(micros, 0);
+        }
+        return (uint16_t)(0x8000 | min<int64_t>(micros / 1000, 0x7fff));
+    }
+
+    static int64_t UnpackLatency(uint16_t latency) {
+        return latency & 0x8000 ? (int64_t)(latency & 0x7fff) * 1000 : latency;
+    }
+
+    uint16_t move;          // Step::Encode(), NONE_CODE ends the game
+    uint16_t latency;       // PackLatency of the search, the winner in the end ply
+};
+
+static_assert(sizeof(RecordEngine) == 40 && sizeof(GameRecordHeader) == 104 && sizeof(RecordPly) == 4,
+              "the record layout is the file format");
+
+// Appends whole games to a file, one game at a time whichever thread plays it
+class GameRecorder {
+public:
+    GameRecorder()
+    :file(NULL), games(0) {
+    }
+
+    ~GameRecorder() {
+        Close();
+    }
+
+    GameRecorder(const GameRecorder&) = delete;
+    GameRecorder& operator=(const GameRecorder&) = delete;
+
+    // Open path to append to, the games already in it stay
+    bool Open(const char* path) {
+        Close();
+        file = fopen(path, "ab");
+        return file != NULL;
+    }
+
+    bool Close() {
+        bool ok = !file || fclose(file) == 0;
+        file = NULL;
+        return ok;
+    }
+
+    // Append a game and flush it, so that a crash later loses nothing written before. header has plies.size().
+    bool Write(const GameRecordHeader& header, const vector<RecordPly>& plies, int winner) {
+        RecordPly end = {Step::NONE_CODE, (uint16_t)winner};
+        lock_guard<mutex> lock(mtx);
+        if (!file) {
+            return false;
+        }
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+            && fwrite(plies.data(), sizeof(RecordPly), plies.size(), file) == plies.size()
+            && fwrite(&end, sizeof(end), 1, file) == 1 && fflush(file) == 0;
+        games += ok;
+        return ok;
+    }
+
+    uint64_t Games() const {
+        return games;
+    }
+private:
+    FILE* file;
+    mutex mtx;
+    uint64_t games;
+};
+
+// One game of a mapped file, its steps point into the mapping
+struct GameRecord {
+    GameRecordHeader header;
+    const RecordPly* plies;
+    size_t plyNumber;       // without the end ply, the ones left of an incomplete game
+    int winner;             // 0 for a draw or an incomplete game
+    bool complete;          // has its end ply
+};
+
+/*
+ Streams the games of a record file. The file is mapped, not read, and a game
+ is only its header copied out and a pointer to its steps, so files of any
+ size go through in constant memory.
+ */
+class GameRecordReader {
+public:
+    GameRecordReader()
+    :data(NULL), size(0), offset(0), corrupt(0) {
+    }
+
+    ~GameRecordReader() {
+        Close();
+    }
+
+    GameRecordReader(const GameRecordReader&) = delete;
+    GameRecordReader& operator=(const GameRecordReader&) = delete;
+
+    bool Open(const char* path) {
+        Close();
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return false;
+        }
+        if (st.st_size == 0) {
+            close(fd);
+            return true;
+        }
+        void* mapped = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            return false;
+        }
+        madvise(mapped, (size_t)st.st_size, MADV_SEQUENTIAL);
+        data = (const uint8_t*)mapped;
+        size = (size_t)st.st_size;
+        return true;
+    }
+
+    void Close() {
+        if (data) {
+            munmap((void*)data, size);
+        }
+        data = NULL;
+        size = 0;
+        offset = 0;
+        corrupt = 0;
+    }
+
+    // The next game, false at the end of the file. Bytes that are not a game are skipped and counted by Corrupt.
+    bool Next(GameRecord& game) {
+        while (offset < size) {
+            if (size - offset < sizeof(GameRecordHeader) || memcmp(data + offset, GameRecordHeader::MAGIC, 8) != 0) {
+                corrupt++;
+                offset = FindGame(offset + 1);
+                continue;
+            }
+            // games only start 4 byte aligned, or anywhere after a cut off one, so the header is copied
+            memcpy(&game.header, data + offset, sizeof(GameRecordHeader));
+            size_t start = offset + sizeof(GameRecordHeader);
+            game.plies = (const RecordPly*)(data + start);
+            game.plyNumber = game.header.plyNumber;
+            size_t end = start + game.plyNumber * sizeof(RecordPly);
+            RecordPly last = {0, 0};
+            if (game.plyNumber < (size - start) / sizeof(RecordPly)) {
+                memcpy(&last, data + end, sizeof(last));
+            }
+            if (last.move == Step::NONE_CODE) {
+                game.complete = true;
+                game.winner = last.latency;
+                offset = end + sizeof(RecordPly);
+                return true;
+            }
+            // cut off: its steps go on until the next game, if any
+            offset = FindGame(start);
+            game.plyNumber = min(game.plyNumber, (offset - start) / sizeof(RecordPly));
+            game.complete = false;
+            game.winner = 0;
+            return true;
+        }
+        return false;
+    }
+
+    // Stretches of bytes that were not a game
+    uint64_t Corrupt() const {
+        return corrupt;
+    }
+
+    /*
+     Replay game from the empty board, calling visit(board, round, step, micros)
+     with the board before every step. False at the first step FindPossibleSteps
+     would not give, visit has seen the steps before it.
+     */
+    template<typename Visit>
+    static bool Replay(const GameRecord& game, Visit visit) {
+        Board board;
+        int round = 0, toMove = Board::FIRST_TAG;
+        for (size_t i = 0; i < game.plyNumber; ++i) {
+            Step step = Step::Decode(game.plies[i].move, toMove);
+            if (!Possible(board, step, round)) {
+                return false;
+            }
+            visit(board, round, step, RecordPly::UnpackLatency(game.plies[i].latency));
+            board.ApplyStep(step, round);
+            round = Board::NextRound(toMove, round);
+            toMove = Board::Opponent(toMove);
+        }
+        return true;
+    }
+private:
+    // Whether step is one of FindPossibleSteps, without generating them all
+    static bool Possible(const Board& board, const Step& step, int round) {
+        int player = step.playerTag, opponent = Board::Opponent(player);
+        size_t to;
+        if (step.type == Step::PLACE) {
+            if (round >= 9 || step.placePos >= 24 || !board.EmptyAt(step.placePos)) {
+                return false;
+            }
+            to = step.placePos;
+        } else {
+            if (round < 9 || step.moveFrom >= 24 || step.moveTo >= 24 || board.At(step.moveFrom) != player
+                || !(Board::tables.nexts[step.moveFrom] >> step.moveTo & 1) || !board.EmptyAt(step.moveTo)) {
+                return false;
+            }
+            to = step.moveTo;
+        }
+        // a step that makes a san eats one of the pieces FindToEat allows, any other eats nothing
+        uint32_t toEat = board.CanMakeSan(player, to, step.type == Step::MOVE ? step.moveFrom : Step::NONE_POS)
+            ? board.FindToEat(opponent).Mask() : 0;
+        return step.eatPos == Step::NONE_POS ? toEat == 0 : step.eatPos < 24 && (toEat >> step.eatPos & 1);
+    }
+
+    // Offset of the first magic at or after from, size if there is none
+    size_t FindGame(size_t from) const {
+        if (from >= size) {
+            return size;
+        }
+        const void* found = memmem(data + from, size - from, GameRecordHeader::MAGIC, 8);
+        return found ? (size_t)((const uint8_t*)found - data) : size;
+    }
+
+    const uint8_t* data;
+    size_t size;
+    size_t offset;      // of the next game
+    uint64_t corrupt;
+};
+
+/*
+ What a set of record files shows, counted in parallel with a task per file:
+ the most frequent positions of the openings up to symmetry, when the sans
+ are made, and how long the engines took per step.
+ */
+class RecordAnalysis {
+public:
+    static const int OPENING_PLIES = 10;        // positions after more steps are too many to count
+    static const int LATENCY_BUCKETS = 26;      // powers of 2 of micros, up to half a minute
+    static const int ROUND_BUCKETS = 40;        // the last one counts every later round
+
+    struct Position {
+        Board board;        // canonical
+        int toMove;
+        int round;
+        uint64_t count;
+    };
+
+    struct Totals {
+        Totals()
+        :files(0), games(0), incomplete(0), corrupt(0), plies(0), withoutSan(0) {
+            memset(winners, 0, sizeof(winners));
+            memset(sans, 0, sizeof(sans));
+            memset(firstSans, 0, sizeof(firstSans));
+            memset(latency, 0, sizeof(latency));
+        }
+
+        void Merge(const Totals& other) {
+            files += other.files;
+            games += other.games;
+            incomplete += other.incomplete;
+            corrupt += other.corrupt;
+            plies += other.plies;
+            withoutSan += other.withoutSan;
+            for (int i = 0; i < 3; ++i) {
+                winners[i] += other.winners[i];
+            }
+            for (int i = 0; i < ROUND_BUCKETS; ++i) {
+                sans[i] += other.sans[i];
+                firstSans[i] += other.firstSans[i];
+            }
+            for (int t = 0; t <= EngineConfig::HUMAN; ++t) {
+                for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+                    latency[t][i] += other.latency[t][i];
+                }
+            }
+            for (auto& item: other.positions) {
+                auto inserted = positions.insert(item);
+                if (!inserted.second) {
+                    inserted.first->second.count += item.second.count;
+                }
+            }
+        }
+
+        uint64_t files, games, incomplete, corrupt, plies;
+        uint64_t winners[3];                    // draws, first, second
+        uint64_t sans[ROUND_BUCKETS];           // steps that eat, per round
+        uint64_t firstSans[ROUND_BUCKETS];      // games by the round of their first san
+        uint64_t withoutSan;
+        uint64_t latency[EngineConfig::HUMAN + 1][LATENCY_BUCKETS];    // steps per engine type and bucket
+        unordered_map<uint64_t, Position> positions;                   // by Symmetry::CanonicalHash
+    };
+
+    // Count the games of paths on threads threads, files that cannot be opened are counted corrupt
+    static Totals Run(const vector<string>& paths, size_t threads) {
+        Totals totals;
+        mutex mtx;
+        ThreadPool pool(max(threads, (size_t)1));
+        for (auto& path: paths) {
+            pool.Submit([&totals, &mtx, &path](size_t) {
+                Totals local;
+                CountFile(path.c_str(), local);
+                lock_guard<mutex> lock(mtx);
+                totals.Merge(local);
+            });
+        }
+        pool.Wait();
+        return totals;
+    }
+
+    static void CountFile(const char* path, Totals& totals) {
+        GameRecordReader reader;
+        totals.files++;
+        if (!reader.Open(path)) {
+            totals.corrupt++;
+            return;
+        }
+        GameRecord game;
+        while (reader.Next(game)) {
+            CountGame(game, totals);
+        }
+        totals.corrupt += reader.Corrupt();
+    }
+
+    static void CountGame(const GameRecord& game, Totals& totals) {
+        // what the game adds is kept aside until the whole game replayed
+        struct Seen {
+            uint8_t bucket;         // round
+            uint8_t eats;
+            uint8_t type;
+            uint8_t latency;        // LatencyBucket
+        };
+        static thread_local vector<Seen> seen;
+        Position openings[OPENING_PLIES];
+        uint64_t keys[OPENING_PLIES];
+        seen.clear();
+        bool replayed = GameRecordReader::Replay(game, [&](const Board& board, int round, const Step& step,
+                                                           int64_t micros) {
+            if (seen.size() < OPENING_PLIES) {
+                int transform;
+                Position& position = openings[seen.size()];
+                position.board = Symmetry::Canonical(board, transform);
+                position.toMove = step.playerTag;
+                position.round = round;
+                position.count = 1;
+                keys[seen.size()] = position.board.Hash(step.playerTag, round);
+            }
+            seen.push_back(Seen{(uint8_t)min(round, ROUND_BUCKETS - 1), step.eatPos != Step::NONE_POS,
+                                game.header.engines[step.playerTag - 1].type, (uint8_t)LatencyBucket(micros)});
+        });
+        if (!replayed) {
+            totals.corrupt++;
+            return;
+        }
+
+        int firstSan = -1;
+        for (size_t i = 0; i < seen.size(); ++i) {
+            const Seen& ply = seen[i];
+            if (ply.eats) {
+                totals.sans[ply.bucket]++;
+                if (firstSan < 0) {
+                    firstSan = ply.bucket;
+                }
+            }
+            if (ply.type <= EngineConfig::HUMAN) {
+                totals.latency[ply.type][ply.latency]++;
+            }
+            if (i < OPENING_PLIES) {
+                auto inserted = totals.positions.insert(make_pair(keys[i], openings[i]));
+                if (!inserted.second) {
+                    inserted.first->second.count++;
+                }
+            }
+        }
+        totals.plies += seen.size();
+        totals.games++;
+        if (!game.complete) {
+            totals.incomplete++;
+            return;
+        }
+        totals.winners[game.winner <= Board::SECOND_TAG ? game.winner : 0]++;
+        if (firstSan < 0) {
+            totals.withoutSan++;
+        } else {
+            totals.firstSans[firstSan]++;
+        }
+    }
+
+    // Bucket i holds the latencies below 2^(i + 1) micros
+    static int LatencyBucket(int64_t micros) {
+        int bucket = micros > 1 ? 63 - __builtin_clzll((uint64_t)micros) : 0;
+        return min(bucket, LATENCY_BUCKETS - 1);
+    }
+
+    static void Print(const Totals& totals, double seconds, size_t topPositions = 10) {
+        printf("%llu files, %llu games (%llu incomplete, %llu corrupt), %llu steps in %.2f s, %.0f steps/s\n",
+               (unsigned long long)totals.files, (unsigned long long)totals.games,
+               (unsigned long long)totals.incomplete, (unsigned long long)totals.corrupt,
+               (unsigned long long)totals.plies, seconds, seconds > 0 ? totals.plies / seconds : 0);
+        printf("Winners: first %llu, second %llu, draws %llu\n", (unsigned long long)totals.winners[1],
+               (unsigned long long)totals.winners[2], (unsigned long long)totals.winners[0]);
+
+        vector<const Position*> positions;
+        for (auto& item: totals.positions) {
+            positions.push_back(&item.second);
+        }
+        size_t top = min(topPositions, positions.size());
+        partial_sort(positions.begin(), positions.begin() + top, positions.end(),
+                     [](const Position* a, const Position* b) {
+            return a->count > b->count || (a->count == b->count && a->board.ToString() < b->board.ToString());
+        });
+        printf("\nMost frequent positions of the first %d steps, up to symmetry:\n", OPENING_PLIES);
+        for (size_t i = 0; i < top; ++i) {
+            const Position& position = *positions[i];
+            printf("  %s round %2d, %d to move: %llu\n", position.board.ToString().c_str(), position.round,
+                   position.toMove, (unsigned long long)position.count);
+        }
+
+        printf("\nSans per round, and games by the round of their first san:\n");
+        for (int i = 0; i < ROUND_BUCKETS; ++i) {
+            if (totals.sans[i] || totals.firstSans[i]) {
+                printf("  round %2d%s: %10llu sans %10llu first\n", i, i == ROUND_BUCKETS - 1 ? "+" : " ",
+                       (unsigned long long)totals.sans[i], (unsigned long long)totals.firstSans[i]);
+            }
+        }
+        printf("  never: %llu games\n", (unsigned long long)totals.withoutSan);
+
+        printf("\nSteps per engine by latency:\n");
+        for (int t = 0; t <= EngineConfig::HUMAN; ++t) {
+            uint64_t steps = 0;
+            for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+                steps += totals.latency[t][i];
+            }
+            if (steps == 0) {
+                continue;
+            }
+            printf("  %s, %llu steps\n", EngineConfig::TypeName((EngineConfig::Type)t), (unsigned long long)steps);
+            for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+                if (totals.latency[t][i]) {
+                    printf("    < %10.3f ms %10llu\n", (2ull << i) / 1000.0, (unsigned long long)totals.latency[t][i]);
+                }
+            }
+        }
+    }
+};
+
+#endif /* record_h */
@@ -0,0 +1,90 @@
+//
+//  rng.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef rng_h
+#define rng_h
+
+#include <cstdint>
+#include "posset.h"
+
+using namespace std;
+
+/*
+ xoshiro256** random engine. It is small enough to keep one per thread or per
+ game and is fully determined by its seed, so games can be replayed exactly.
+ */
+class Rng {
+public:
+    typedef uint64_t result_type;
+
+    explicit Rng(uint64_t seed = 0) {
+        Seed(seed);
+    }
+
+    void Seed(uint64_t seed) {
+        // expand the seed with splitmix64, so that close seeds give unrelated states
+        for (int i = 0; i < 4; ++i) {
+            seed += 0x9e3779b97f4a7c15ull;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            s[i] = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t Next() {
+        uint64_t result = Rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = Rotl(s[3], 45);
+        return result;
+    }
+
+    uint64_t operator()() {
+        return Next();
+    }
+
+    static constexpr uint64_t min() {
+        return 0;
+    }
+
+    static constexpr uint64_t max() {
+        return ~0ull;
+    }
+
+    // Uniform in [0, bound) without modulo bias (Lemire's multiply and reject), bound must not be 0
+    uint32_t Bounded(uint32_t bound) {
+        uint64_t m = (uint64_t)(uint32_t)(Next() >> 32) * bound;
+        uint32_t low = (uint32_t)m;
+        if (low < bound) {
+            uint32_t threshold = (uint32_t)(-bound) % bound;
+            while (low < threshold) {
+                m = (uint64_t)(uint32_t)(Next() >> 32) * bound;
+                low = (uint32_t)m;
+            }
+        }
+        return (uint32_t)(m >> 32);
+    }
+
+    // A uniformly chosen position of a non empty mask
+    size_t PickBit(uint32_t mask) {
+        return PosSet(mask).Nth(Bounded((uint32_t)__builtin_popcount(mask)));
+    }
+private:
+    static uint64_t Rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    uint64_t s[4];
+};
+
+#endif /* rng_h */
@@ -0,0 +1,100 @@
+//
+//  search.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef search_h
+#define search_h
+
+#include <chrono>
+#include <cstdint>
+
+using namespace std;
+
+/*
+ How much work a search may do for one step, 0 means no limit. A search stops
+ at the first limit it hits and still returns the best step it has found so far.
+ */
+struct SearchLimits {
+    SearchLimits(int64_t maxMillis = 0, uint64_t maxPlayouts = 0, uint64_t maxNodes = 0, int maxDepth = 0)
+    :maxMillis(maxMillis), maxPlayouts(maxPlayouts), maxNodes(maxNodes), maxDepth(maxDepth) {
+    }
+
+    static SearchLimits Millis(int64_t millis) {
+        return SearchLimits(millis, 0, 0);
+    }
+
+    static SearchLimits Playouts(uint64_t playouts) {
+        return SearchLimits(0, playouts, 0);
+    }
+
+    static SearchLimits Nodes(uint64_t nodes) {
+        return SearchLimits(0, 0, nodes);
+    }
+
+    static SearchLimits Depth(int depth) {
+        return SearchLimits(0, 0, 0, depth);
+    }
+
+    // No limit SearchClock checks, maxDepth is left to the searches that have a depth
+    bool Unlimited() const {
+        return maxMillis <= 0 && maxPlayouts == 0 && maxNodes == 0;
+    }
+
+    int64_t maxMillis;
+    uint64_t maxPlayouts;
+    uint64_t maxNodes;
+    int maxDepth;       // only for tree searches with a depth
+};
+
+// How much work a search actually did
+struct SearchInfo {
+    SearchInfo()
+    :playouts(0), nodes(0), micros(0), depth(0), score(0), cutOff(false), proved(false) {
+    }
+
+    uint64_t playouts;
+    uint64_t nodes;     // positions visited, the meaning differs a bit per engine
+    int64_t micros;
+    int depth;          // deepest finished iteration of a depth first search
+    int score;          // its score for the player to move
+    bool cutOff;        // stopped by a limit before finishing its own plan
+    bool proved;        // the step wins by force, proved before any search
+};
+
+// Wall clock of a search, started on construction
+class SearchClock {
+public:
+    explicit SearchClock(const SearchLimits& limits)
+    :limits(limits), start(chrono::steady_clock::now()) {
+    }
+
+    int64_t ElapsedMicros() const {
+        return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    }
+
+    bool TimeUp() const {
+        return limits.maxMillis > 0 && ElapsedMicros() >= limits.maxMillis * 1000;
+    }
+
+    bool Done(uint64_t playouts, uint64_t nodes) const {
+        return (limits.maxPlayouts > 0 && playouts >= limits.maxPlayouts)
+            || (limits.maxNodes > 0 && nodes >= limits.maxNodes)
+            || TimeUp();
+    }
+
+    void Finish(SearchInfo& info, uint64_t playouts, uint64_t nodes, bool cutOff) const {
+        info.playouts = playouts;
+        info.nodes = nodes;
+        info.micros = ElapsedMicros();
+        info.cutOff = cutOff;
+    }
+private:
+    SearchLimits limits;
+    chrono::steady_clock::time_point start;
+};
+
+#endif /* search_h */
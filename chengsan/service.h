@@ -0,0 +1,351 @@
+//
+//  service.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef service_h
+#define service_h
+
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "board.h"
+#include "mcts.h"
+#include "dfpn.h"
+#include "search.h"
+#include "threadpool.h"
+#include "utils.h"
+
+using namespace std;
+
+/*
+ Analysis service: a long running engine that reads commands, one per line,
+ and analyses many positions at once. Every request has an id the client
+ picks, and every answer starts with the id it is about.
+
+ Commands:
+   position <id> <board> <round> <side>   board is 24 characters of .12*, side is 1 or 2
+   go <id> [millis <n>] [playouts <n>] [nodes <n>]
+                                          analyse until a limit, or until stop without one
+   stop [<id>]                            stop one request or all, each still gets its bestmove
+   forget <id>                            stop the request and drop it with its tree
+   stats                                  one stats line
+   quit                                   stop everything and exit, as the end of input does
+
+ Answers:
+   info <id> <step> score <per mille> playouts <n> nodes <n> millis <n>
+   bestmove <id> <step> score <per mille> playouts <n> nodes <n> millis <n> [proved]
+   stats requests <n> running <n> queued <n> slices <n> playouts <n> threads <n>
+   error <message>
+
+ Steps are written by Step::ToString, scores are the win rate of the step for
+ the side to move. info comes whenever the best step changes and at least every
+ INFO_MILLIS while a request runs.
+
+ Requests run MCTS in slices of SLICE_MILLIS on a shared pool. A request
+ that is not done goes back to the end of a FIFO queue, so with more requests
+ than threads each one gets a slice in turn. The tree of a request is kept
+ between its slices and between go commands on the same position. Before the
+ first slice a ProofSolver pre-pass looks for a forced win.
+
+ Every request holds a tree of TREE_NODES nodes until it is forgotten. Beyond
+ MAX_REQUESTS the idle request used least recently is dropped, so a client
+ that comes back to an old id may have to send its position again.
+ */
+class AnalysisService {
+public:
+    static const int64_t SLICE_MILLIS = 20;
+    static const int64_t INFO_MILLIS = 250;
+    static const size_t TREE_NODES = 1 << 18;  // per request, many trees share the memory
+    static const size_t MAX_REQUESTS = 64;      // idle ones past this are dropped
+
+    AnalysisService(size_t threads, uint64_t seed, FILE* out = stdout)
+    :out(out), seed(seed), created(0), used(0), slices(0), playouts(0), running(0), pool(max(threads, (size_t)1)) {
+        for (size_t i = 0; i < pool.Size(); ++i) {
+            solvers.emplace_back(new ProofSolver(1 << 15));
+        }
+    }
+
+    ~AnalysisService() {
+        StopAll();
+        pool.Wait();
+    }
+
+    // Handle the commands of in until quit or its end, returns once every request has stopped
+    void Run(FILE* in) {
+        char line[1024];
+        while (fgets(line, sizeof(line), in) && Handle(line)) {
+        }
+        StopAll();
+        pool.Wait();
+    }
+
+    // Handle one command line, false for quit
+    bool Handle(const string& line) {
+        istringstream words(line);
+        string command, id;
+        if (!(words >> command)) {
+            return true;
+        }
+        if (command == "quit") {
+            return false;
+        }
+        if (command == "stats") {
+            lock_guard<mutex> lock(mtx);
+            Emit("stats requests %zu running %zu queued %zu slices %llu playouts %llu threads %zu", requests.size(),
+                 running, ready.size(), (unsigned long long)slices, (unsigned long long)playouts, pool.Size());
+            return true;
+        }
+        if (command == "stop" && !(words >> id)) {
+            StopAll();
+            return true;
+        }
+        if (command != "stop" && !(words >> id)) {
+            Emit("error %s needs a request id", command.c_str());
+            return true;
+        }
+
+        lock_guard<mutex> lock(mtx);
+        auto found = requests.find(id);
+        shared_ptr<Request> request = found == requests.end() ? nullptr : found->second;
+        if (request) {
+            request->lastUsed = ++used;
+        }
+        if (command == "position") {
+            string text;
+            int round = -1, side = 0;
+            Board board;
+            if (!(words >> text >> round >> side) || !Board::FromString(text, board) || round < 0
+                || (side != Board::FIRST_TAG && side != Board::SECOND_TAG)) {
+                Emit("error %s: position wants <board> <round> <side>", id.c_str());
+            } else if (request && request->running) {
+                Emit("error %s is running", id.c_str());
+            } else if (!request || !(request->board == board && request->toMove == side && request->round == round)) {
+                // a new position starts a new tree, the same one keeps it
+                request = make_shared<Request>(id, board, side, round, Utils::Mix(seed, ++created));
+                request->lastUsed = ++used;
+                requests[id] = request;
+                DropIdle();
+            }
+        } else if (command == "go") {
+            SearchLimits limits;
+            string name;
+            int64_t value;
+            bool ok = true;
+            while (ok && words >> name) {
+                ok = (bool)(words >> value) && value > 0;
+                if (ok && name == "millis") {
+                    limits.maxMillis = value;
+                } else if (ok && name == "playouts") {
+                    limits.maxPlayouts = (uint64_t)value;
+                } else if (ok && name == "nodes") {
+                    limits.maxNodes = (uint64_t)value;
+                } else {
+                    ok = false;
+                }
+            }
+            if (!request) {
+                Emit("error %s has no position", id.c_str());
+            } else if (request->running) {
+                Emit("error %s is running", id.c_str());
+            } else if (!ok) {
+                Emit("error %s: go takes millis, playouts and nodes with positive values", id.c_str());
+            } else if (request->board.FindPossibleSteps(request->toMove, request->round).empty()) {
+                Emit("error %s has no steps", id.c_str());
+            } else {
+                request->limits = limits;
+                request->start = chrono::steady_clock::now();
+                request->lastInfo = request->start;
+                request->playouts = 0;
+                request->cancel = false;
+                request->running = true;
+                running++;
+                Schedule(request);
+            }
+        } else if (command == "stop" || command == "forget") {
+            if (!request) {
+                Emit("error %s has no position", id.c_str());
+            } else {
+                // a running request still answers bestmove, its last slice holds it until then
+                request->cancel = true;
+                if (command == "forget") {
+                    requests.erase(id);
+                }
+            }
+        } else {
+            Emit("error unknown command %s", command.c_str());
+        }
+        return true;
+    }
+private:
+    struct Request {
+        Request(const string& id, const Board& board, int toMove, int round, uint64_t seed)
+        :id(id), board(board), toMove(toMove), round(round),
+        mcts(new MctsPlayer(toMove, Board::Opponent(toMove), seed, TREE_NODES)), cancel(false), running(false),
+        checked(false), playouts(0), lastBest(Step::MakePlaceStep(toMove, Step::NONE_POS)), lastUsed(0) {
+        }
+
+        string id;
+        Board board;
+        int toMove;
+        int round;
+        unique_ptr<MctsPlayer> mcts;
+        atomic<bool> cancel;
+        bool running;           // guarded by mtx, the rest only changes while it is false or in a slice
+        bool checked;           // the pre-pass ran on this position
+        SearchLimits limits;
+        chrono::steady_clock::time_point start, lastInfo;
+        uint64_t playouts;      // of the current go
+        Step lastBest;
+        uint64_t lastUsed;      // the value of used when a command last named it
+    };
+
+    // Drop the idle requests used least recently until there are at most MAX_REQUESTS, mtx must be held
+    void DropIdle() {
+        while (requests.size() > MAX_REQUESTS) {
+            auto oldest = requests.end();
+            for (auto it = requests.begin(); it != requests.end(); ++it) {
+                if (!it->second->running && (oldest == requests.end()
+                                             || it->second->lastUsed < oldest->second->lastUsed)) {
+                    oldest = it;
+                }
+            }
+            if (oldest == requests.end()) {
+                break;
+            }
+            requests.erase(oldest);
+        }
+    }
+
+    // Queue a slice of request, mtx must be held
+    void Schedule(const shared_ptr<Request>& request) {
+        ready.push_back(request);
+        pool.Submit([this](size_t worker) {
+            shared_ptr<Request> next;
+            {
+                lock_guard<mutex> lock(mtx);
+                next = ready.front();
+                ready.pop_front();
+            }
+            if (RunSlice(*next, worker)) {
+                lock_guard<mutex> lock(mtx);
+                Schedule(next);
+            }
+        });
+    }
+
+    // One slice of request on pool worker worker, false once it finished the request
+    bool RunSlice(Request& request, size_t worker) {
+        SearchInfo info;
+        Step best;
+        if (!request.checked) {
+            request.checked = true;
+            MoveList steps;
+            request.board.FindPossibleSteps(request.toMove, request.round, steps);
+            if (steps.size() == 1) {
+                info.score = 500;
+                Finish(request, steps[0], info, false);
+                return false;
+            }
+            if (solvers[worker]->ProveWin(request.board, request.toMove, request.round, ProofSolver::PREPASS_BUDGET,
+                                          best)) {
+                info.nodes = solvers[worker]->Nodes();
+                info.score = 1000;
+                Finish(request, best, info, true);
+                return false;
+            }
+        }
+
+        const SearchLimits& limits = request.limits;
+        SearchLimits slice = SearchLimits::Millis(SLICE_MILLIS);
+        if (limits.maxMillis > 0) {
+            int64_t left = limits.maxMillis - Millis(request.start);
+            slice.maxMillis = left < SLICE_MILLIS ? max<int64_t>(1, left) : SLICE_MILLIS;
+        }
+        if (limits.maxPlayouts > 0) {
+            slice.maxPlayouts = limits.maxPlayouts - request.playouts;
+        }
+        slice.maxNodes = limits.maxNodes;
+        best = request.mcts->Analyse(request.board, request.round, slice, &info, &request.cancel);
+        request.playouts += info.playouts;
+        {
+            lock_guard<mutex> lock(mtx);
+            slices++;
+            playouts += info.playouts;
+        }
+
+        bool done = request.cancel || (limits.maxMillis > 0 && Millis(request.start) >= limits.maxMillis)
+            || (limits.maxPlayouts > 0 && request.playouts >= limits.maxPlayouts)
+            || (limits.maxNodes > 0 && info.nodes >= limits.maxNodes) || info.playouts == 0;
+        if (done) {
+            Finish(request, best, info, false);
+            return false;
+        }
+        if (best != request.lastBest || Millis(request.lastInfo) >= INFO_MILLIS) {
+            request.lastBest = best;
+            request.lastInfo = chrono::steady_clock::now();
+            Emit("info %s %s score %d playouts %llu nodes %llu millis %lld", request.id.c_str(),
+                 best.ToString().c_str(), info.score, (unsigned long long)request.playouts,
+                 (unsigned long long)info.nodes, (long long)Millis(request.start));
+        }
+        return true;
+    }
+
+    // Answer bestmove and end the request, under mtx so stats never counts it running after its answer
+    void Finish(Request& request, const Step& best, const SearchInfo& info, bool proved) {
+        lock_guard<mutex> lock(mtx);
+        Emit("bestmove %s %s score %d playouts %llu nodes %llu millis %lld%s", request.id.c_str(),
+             best.ToString().c_str(), info.score, (unsigned long long)request.playouts, (unsigned long long)info.nodes,
+             (long long)Millis(request.start), proved ? " proved" : "");
+        request.running = false;
+        running--;
+    }
+
+    void StopAll() {
+        lock_guard<mutex> lock(mtx);
+        for (auto& item: requests) {
+            item.second->cancel = true;
+        }
+    }
+
+    static int64_t Millis(chrono::steady_clock::time_point since) {
+        return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - since).count();
+    }
+
+    // Write one answer line, whole
+    void Emit(const char* format, ...) {
+        lock_guard<mutex> lock(outMtx);
+        va_list args;
+        va_start(args, format);
+        vfprintf(out, format, args);
+        va_end(args);
+        fputc('\n', out);
+        fflush(out);
+    }
+
+    FILE* out;
+    mutex outMtx;
+    uint64_t seed;
+    uint64_t created;       // requests made, seeds their searches
+    uint64_t used;          // commands that named a request, orders them for DropIdle
+    mutex mtx;              // guards the requests, the queue and the stats
+    map<string, shared_ptr<Request>> requests;
+    deque<shared_ptr<Request>> ready;
+    uint64_t slices, playouts;
+    size_t running;
+    vector<unique_ptr<ProofSolver>> solvers;    // one per pool worker
+    ThreadPool pool;        // last, its threads stop before the rest goes
+};
+
+#endif /* service_h */
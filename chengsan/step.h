@@ -9,21 +9,38 @@
 #ifndef step_h
 #define step_h
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ A step packed into 32 bits. Positions take 5 bits, NONE_POS is the one value
+ above the 24 positions that fits. placePos shares its bits with moveFrom.
+ */
 class Step {
 public:
-    enum{PLACE, MOVE} type;
-    size_t eatPos;
-    int playerTag;
-    
-    static const size_t NONE_POS = 822;
+    enum {PLACE, MOVE};
+
+    static const size_t NONE_POS = 31;
 
     union {
         struct {
-            size_t moveFrom, moveTo;
+            uint32_t type: 1;
+            uint32_t playerTag: 2;
+            uint32_t eatPos: 5;
+            uint32_t moveFrom: 5;
+            uint32_t moveTo: 5;
         };
-        size_t placePos;
+        struct {
+            uint32_t: 8;
+            uint32_t placePos: 5;
+        };
+        uint32_t bits;      // every field at once, the unused high bits are 0
     };
 
+    // Left uninitialized, so that lists of steps cost nothing to create
+    Step() = default;
+
     static Step MakePlaceStep(int player, size_t placePos, size_t eatPos = NONE_POS) {
         return Step(player, placePos, eatPos);
     }
@@ -32,14 +49,63 @@ public:
         return Step(player, moveFrom, moveTo, eatPos);
     }
 
+    // 16-bit code of a step without its player: type | from (or place) | to | eat, 5 bits each
+    static const uint16_t NONE_CODE = 0xffff;
+
+    uint16_t Encode() const {
+        return (uint16_t)(type | moveFrom << 1 | moveTo << 6 | eatPos << 11);
+    }
+
+    static Step Decode(uint16_t code, int player) {
+        size_t from = DecodePos(code >> 1), to = DecodePos(code >> 6), eat = DecodePos(code >> 11);
+        if (code & 1) {
+            return MakeMoveStep(player, from, to, eat);
+        }
+        return MakePlaceStep(player, from, eat);
+    }
+
+    // The place position or "from-to", then "x" and the eaten position if any: "5", "3-4x17"
+    std::string ToString() const {
+        std::string text = type == MOVE ? std::to_string(moveFrom) + "-" + std::to_string(moveTo)
+                                        : std::to_string(placePos);
+        if (eatPos != NONE_POS) {
+            text += "x" + std::to_string(eatPos);
+        }
+        return text;
+    }
+
+    bool operator==(const Step& other) const {
+        return playerTag == other.playerTag && Encode() == other.Encode();
+    }
+
+    bool operator!=(const Step& other) const {
+        return !(*this == other);
+    }
+
 private:
-    Step(int player, size_t placePos, size_t eatPos)
-    :playerTag(player), placePos(placePos), eatPos(eatPos), type(PLACE) {
+    static size_t DecodePos(uint16_t code) {
+        return code & 31;
+    }
+
+    Step(int player, size_t placePos, size_t eatPos) {
+        bits = 0;
+        type = PLACE;
+        playerTag = (uint32_t)player;
+        this->eatPos = (uint32_t)eatPos;
+        moveFrom = (uint32_t)placePos;
+        moveTo = NONE_POS;
     }
 
-    Step(int player, size_t moveFrom, size_t moveTo, size_t eatPos)
-    :playerTag(player), moveFrom(moveFrom), moveTo(moveTo), eatPos(eatPos), type(MOVE) {
+    Step(int player, size_t moveFrom, size_t moveTo, size_t eatPos) {
+        bits = 0;
+        type = MOVE;
+        playerTag = (uint32_t)player;
+        this->eatPos = (uint32_t)eatPos;
+        this->moveFrom = (uint32_t)moveFrom;
+        this->moveTo = (uint32_t)moveTo;
     }
 };
 
+static_assert(sizeof(Step) == 4, "Step should pack into 32 bits");
+
 #endif /* step_h */
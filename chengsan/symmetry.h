@@ -0,0 +1,171 @@
+//
+//  symmetry.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef symmetry_h
+#define symmetry_h
+
+#include <cstdint>
+#include "board.h"
+#include "step.h"
+
+using namespace std;
+
+/*
+ The 16 symmetries of the board: the 8 rotations and reflections of the square
+ times swapping the inner and the outer rings.
+
+ Every ring is numbered clockwise from its top left corner, so a rotation or a
+ reflection maps position k of a ring to position map(k) of the same ring, and
+ the ring swap exchanges ring 0 and ring 2. Transform t rotates by 90 degrees
+ (t & 3) times after mirroring left to right if t & 4, then swaps the rings if
+ t & 8. Board masks keep a ring per byte, so a transform is 3 byte lookups.
+ */
+struct SymmetryTables {
+    static constexpr int TRANSFORM_NUMBER = 16;
+
+    uint8_t positions[TRANSFORM_NUMBER][24];    // image of each position
+    uint8_t rings[TRANSFORM_NUMBER / 2][256];   // image of a ring byte, without the ring swap
+    uint8_t inverses[TRANSFORM_NUMBER];
+
+    static constexpr int MapInRing(int transform, int k) {
+        return (((transform & 4) ? (10 - k) : k) + 2 * (transform & 3)) & 7;
+    }
+
+    static constexpr SymmetryTables Make() {
+        SymmetryTables t = {};
+        for (int transform = 0; transform < TRANSFORM_NUMBER; ++transform) {
+            for (int pos = 0; pos < 24; ++pos) {
+                int ring = pos / 8;
+                if (transform & 8) {
+                    ring = 2 - ring;
+                }
+                t.positions[transform][pos] = (uint8_t)(ring * 8 + MapInRing(transform, pos % 8));
+            }
+        }
+        for (int transform = 0; transform < TRANSFORM_NUMBER / 2; ++transform) {
+            for (int byte = 0; byte < 256; ++byte) {
+                uint8_t image = 0;
+                for (int k = 0; k < 8; ++k) {
+                    if (byte & (1 << k)) {
+                        image |= (uint8_t)(1 << MapInRing(transform, k));
+                    }
+                }
+                t.rings[transform][byte] = image;
+            }
+        }
+        for (int transform = 0; transform < TRANSFORM_NUMBER; ++transform) {
+            for (int other = 0; other < TRANSFORM_NUMBER; ++other) {
+                bool identity = true;
+                for (int pos = 0; pos < 24; ++pos) {
+                    identity = identity && t.positions[other][t.positions[transform][pos]] == pos;
+                }
+                if (identity) {
+                    t.inverses[transform] = (uint8_t)other;
+                }
+            }
+        }
+        return t;
+    }
+};
+
+class Symmetry {
+public:
+    static constexpr int TRANSFORM_NUMBER = SymmetryTables::TRANSFORM_NUMBER;
+    static const int IDENTITY = 0;
+
+    static constexpr SymmetryTables tables = SymmetryTables::Make();
+
+    static size_t Position(int transform, size_t pos) {
+        return pos == Step::NONE_POS ? pos : tables.positions[transform][pos];
+    }
+
+    static uint32_t Mask(int transform, uint32_t mask) {
+        const uint8_t* ring = tables.rings[transform & 7];
+        uint32_t outer = ring[mask & 0xff], middle = ring[(mask >> 8) & 0xff], inner = ring[(mask >> 16) & 0xff];
+        if (transform & 8) {
+            swap(outer, inner);
+        }
+        return outer | middle << 8 | inner << 16;
+    }
+
+    static int Inverse(int transform) {
+        return tables.inverses[transform];
+    }
+
+    static Board Apply(int transform, const Board& board) {
+        return Board::FromMasks(Mask(transform, board.FindFirst().Mask()), Mask(transform, board.FindSecond().Mask()),
+                                Mask(transform, board.FindBlock().Mask()));
+    }
+
+    static Step Apply(int transform, const Step& step) {
+        if (step.type == Step::MOVE) {
+            return Step::MakeMoveStep(step.playerTag, Position(transform, step.moveFrom), Position(transform, step.moveTo),
+                                      Position(transform, step.eatPos));
+        }
+        return Step::MakePlaceStep(step.playerTag, Position(transform, step.placePos), Position(transform, step.eatPos));
+    }
+
+    /*
+     The transform taking board to its canonical form, the image with the
+     smallest (first, second, block) masks. Equal boards under symmetry have
+     the same canonical form; a step found on the canonical board maps back
+     to board with Apply(Inverse(transform), step).
+     */
+    static int CanonicalTransform(const Board& board) {
+        uint32_t first = board.FindFirst().Mask(), second = board.FindSecond().Mask(), block = board.FindBlock().Mask();
+        int best = IDENTITY;
+        uint32_t bestFirst = first, bestSecond = second, bestBlock = block;
+        for (int transform = 1; transform < TRANSFORM_NUMBER; ++transform) {
+            uint32_t f = Mask(transform, first);
+            if (f > bestFirst) {
+                continue;
+            }
+            uint32_t s = Mask(transform, second), b = Mask(transform, block);
+            if (f < bestFirst || s < bestSecond || (s == bestSecond && b < bestBlock)) {
+                best = transform;
+                bestFirst = f;
+                bestSecond = s;
+                bestBlock = b;
+            }
+        }
+        return best;
+    }
+
+    static Board Canonical(const Board& board, int& transform) {
+        transform = CanonicalTransform(board);
+        return transform == IDENTITY ? board : Apply(transform, board);
+    }
+
+    static bool IsCanonical(uint32_t first, uint32_t second) {
+        for (int transform = 1; transform < TRANSFORM_NUMBER; ++transform) {
+            uint32_t f = Mask(transform, first);
+            if (f < first || (f == first && Mask(transform, second) < second)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Board::Hash of the canonical form, the same for every board of a symmetry class
+    static uint64_t CanonicalHash(const Board& board, int playerToMove, int round, int* transform = NULL) {
+        int t;
+        uint64_t hash = Canonical(board, t).Hash(playerToMove, round);
+        if (transform) {
+            *transform = t;
+        }
+        return hash;
+    }
+};
+
+constexpr SymmetryTables Symmetry::tables;
+
+static_assert(Symmetry::tables.positions[1][0] == 2, "rotating moves the top left corner to the top right");
+static_assert(Symmetry::tables.positions[4][0] == 2 && Symmetry::tables.positions[4][1] == 1, "mirroring keeps the middle");
+static_assert(Symmetry::tables.positions[8][17] == 1, "swapping rings keeps the cross lines");
+
+#endif /* symmetry_h */
@@ -0,0 +1,527 @@
+//
+//  tablebase.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef tablebase_h
+#define tablebase_h
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "board.h"
+#include "symmetry.h"
+#include "threadpool.h"
+
+using namespace std;
+
+/*
+ Endgame tablebase of the moving phase: every board without blocks where each
+ player has 3 to maxPieces pieces, for both players to move, in a round after 9
+ (so a player left with 2 pieces loses).
+
+ Values are one byte for the player to move: 0 is a draw, 1-127 a win in that
+ many steps, 128 + n a loss in n steps.
+
+ The boards with f first and s second pieces form the class (f, s). Inside a
+ class, a board is indexed by the combinadic rank of the first pieces among the
+ 24 positions times C(24 - f, s), plus the rank of the second pieces among the
+ 24 - f positions left.
+
+ File layout: a TablebaseHeader, then the value arrays at the offsets it lists.
+ Tablebase maps the file and reads values in place, nothing is parsed on open.
+ */
+struct TablebaseHeader {
+    static constexpr const char* MAGIC = "CSTB0001";
+    static const int MAX_PIECES = 9;
+
+    char magic[8];
+    uint32_t maxPieces;
+    uint32_t reserved;
+    uint64_t offsets[MAX_PIECES + 1][MAX_PIECES + 1][2];     // [first][second][second to move], 0 if absent
+};
+
+struct TablebaseIndex {
+    static const int MIN_PIECES = 3;
+
+    static uint64_t Binomial(int n, int k) {
+        static const struct Table {
+            Table() {
+                for (int i = 0; i <= 24; ++i) {
+                    c[i][0] = 1;
+                    for (int j = 1; j <= i; ++j) {
+                        c[i][j] = c[i - 1][j - 1] + (j < i ? c[i - 1][j] : 0);
+                    }
+                }
+            }
+            uint64_t c[25][25] = {};
+        } table;
+        return k < 0 || k > n ? 0 : table.c[n][k];
+    }
+
+    // Rank of a subset among the subsets of the same size, in colexicographic order
+    static uint64_t Rank(uint32_t mask) {
+        uint64_t rank = 0;
+        int i = 1;
+        for (size_t pos: PosSet(mask)) {
+            rank += Binomial((int)pos, i++);
+        }
+        return rank;
+    }
+
+    // The positions of mask renumbered among the positions not in excluded
+    static uint32_t Compress(uint32_t mask, uint32_t excluded) {
+        uint32_t res = 0;
+        for (size_t pos: PosSet(mask)) {
+            res |= 1u << (pos - __builtin_popcount(excluded & ((1u << pos) - 1)));
+        }
+        return res;
+    }
+
+    // Inverse of Compress
+    static uint32_t Expand(uint32_t compressed, uint32_t excluded) {
+        uint32_t res = 0, free = ~excluded & PosSet::ALL;
+        for (size_t i = 0; free; ++i, free &= free - 1) {
+            if (compressed & (1u << i)) {
+                res |= free & -free;
+            }
+        }
+        return res;
+    }
+
+    // The next larger mask with the same number of bits (Gosper's hack), colexicographic order
+    static uint32_t NextSubset(uint32_t mask) {
+        uint32_t low = mask & -mask, ripple = mask + low;
+        return ripple | (((mask ^ ripple) >> 2) / low);
+    }
+
+    static uint64_t ClassSize(int first, int second) {
+        return Binomial(24, first) * Binomial(24 - first, second);
+    }
+
+    static uint64_t Index(uint32_t first, uint32_t second) {
+        int f = __builtin_popcount(first), s = __builtin_popcount(second);
+        return Rank(first) * Binomial(24 - f, s) + Rank(Compress(second, first));
+    }
+
+    static int Side(int playerToMove) {
+        return playerToMove == Board::SECOND_TAG ? 1 : 0;
+    }
+};
+
+class Tablebase {
+public:
+    enum Result {
+        DRAW,
+        WIN,
+        LOSS
+    };
+
+    Tablebase()
+    :data(NULL), size(0) {
+    }
+
+    ~Tablebase() {
+        Close();
+    }
+
+    Tablebase(const Tablebase&) = delete;
+    Tablebase& operator=(const Tablebase&) = delete;
+
+    // Tablebase the engines probe, NULL when none was opened
+    static const Tablebase*& Shared() {
+        static const Tablebase* shared = NULL;
+        return shared;
+    }
+
+    bool Open(const char* path) {
+        Close();
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TablebaseHeader)) {
+            close(fd);
+            return false;
+        }
+        void* mapped = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            return false;
+        }
+        data = (const uint8_t*)mapped;
+        size = (size_t)st.st_size;
+        if (memcmp(Header().magic, TablebaseHeader::MAGIC, 8) != 0 || !ClassesFit()) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close() {
+        if (data) {
+            munmap((void*)data, size);
+        }
+        data = NULL;
+        size = 0;
+    }
+
+    bool IsOpen() const {
+        return data != NULL;
+    }
+
+    int MaxPieces() const {
+        return data ? (int)Header().maxPieces : 0;
+    }
+
+    // The value of board for playerToMove, false if the board is not in the tablebase
+    bool Probe(const Board& board, int playerToMove, int round, Result& result, int& distance) const {
+        if (!data || round <= 9 || !board.FindBlock().empty()) {
+            return false;
+        }
+        uint32_t first = board.FindFirst().Mask(), second = board.FindSecond().Mask();
+        int f = __builtin_popcount(first), s = __builtin_popcount(second);
+        if (f < TablebaseIndex::MIN_PIECES || s < TablebaseIndex::MIN_PIECES || f > MaxPieces() || s > MaxPieces()) {
+            return false;
+        }
+        uint64_t offset = Header().offsets[f][s][TablebaseIndex::Side(playerToMove)];
+        if (offset == 0) {
+            return false;
+        }
+        Decode(data[offset + TablebaseIndex::Index(first, second)], result, distance);
+        return true;
+    }
+
+    static void Decode(uint8_t value, Result& result, int& distance) {
+        if (value == 0) {
+            result = DRAW;
+            distance = 0;
+        } else if (value < 128) {
+            result = WIN;
+            distance = value;
+        } else {
+            result = LOSS;
+            distance = value - 128;
+        }
+    }
+private:
+    const TablebaseHeader& Header() const {
+        return *(const TablebaseHeader*)data;
+    }
+
+    // Every class Probe may read lies inside the file, so a truncated file is rejected on open
+    bool ClassesFit() const {
+        const TablebaseHeader& header = Header();
+        if (header.maxPieces > (uint32_t)TablebaseHeader::MAX_PIECES) {
+            return false;
+        }
+        for (int f = TablebaseIndex::MIN_PIECES; f <= (int)header.maxPieces; ++f) {
+            for (int s = TablebaseIndex::MIN_PIECES; s <= (int)header.maxPieces; ++s) {
+                for (int side = 0; side < 2; ++side) {
+                    uint64_t offset = header.offsets[f][s][side];
+                    if (offset != 0 && (offset < sizeof(TablebaseHeader) || offset > size
+                                        || TablebaseIndex::ClassSize(f, s) > size - offset)) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    const uint8_t* data;
+    size_t size;
+};
+
+/*
+ Solves the tablebase classes in order of their total number of pieces, a step
+ either keeps the class (switching the player to move) or eats a piece, which
+ leads to a class solved before. Inside a class the boards are resolved in
+ passes: pass n marks the boards won in n steps (a step to a board lost in
+ n - 1) and lost in n steps (every step goes to a board won in at most n - 1).
+ Boards still open when a pass changes nothing are draws.
+ Only canonical boards (see Symmetry) are searched, their value is copied to
+ every symmetric board, so the file keeps its simple dense index.
+ */
+class TablebaseGenerator {
+public:
+    static const int MAX_DISTANCE = 127;
+
+    TablebaseGenerator(int maxPieces, size_t threads = 1)
+    :maxPieces(min(maxPieces, (int)TablebaseHeader::MAX_PIECES)), pool(threads > 1 ? new ThreadPool(threads) : NULL) {
+    }
+
+    // Solve every class, progress goes to log when it is not NULL
+    void Generate(FILE* log = NULL) {
+        values.assign(TablebaseHeader::MAX_PIECES + 1, vector<vector<uint8_t>>(TablebaseHeader::MAX_PIECES + 1));
+        for (int total = 2 * TablebaseIndex::MIN_PIECES; total <= 2 * maxPieces; ++total) {
+            for (int f = TablebaseIndex::MIN_PIECES; f <= maxPieces; ++f) {
+                int s = total - f;
+                if (s < TablebaseIndex::MIN_PIECES || s > maxPieces) {
+                    continue;
+                }
+                SolveClass(f, s, log);
+            }
+        }
+    }
+
+    /*
+     Checks every solved board against its steps, returns how many disagree: a
+     win in n needs a step to a loss in n - 1 and none faster, a loss in n needs
+     every step to lose and the slowest in n, a draw neither.
+     */
+    uint64_t Check(FILE* log = NULL) {
+        uint64_t wrong = 0;
+        for (int f = TablebaseIndex::MIN_PIECES; f <= maxPieces; ++f) {
+            for (int s = TablebaseIndex::MIN_PIECES; s <= maxPieces; ++s) {
+                uint64_t size = TablebaseIndex::ClassSize(f, s);
+                const vector<uint8_t>& both = values[f][s];
+                vector<uint32_t> firsts = Firsts(f);
+                size_t taskNumber = TaskNumber();
+                vector<uint64_t> wrongs(taskNumber, 0);
+                RunTasks(taskNumber, [&](size_t task) {
+                    ForEachCanonical(f, s, firsts, task, taskNumber, [&](uint64_t index, uint32_t first, uint32_t second) {
+                        Board board = Board::FromMasks(first, second);
+                        for (int side = 0; side < 2; ++side) {
+                            int fastestWin, longestLoss;
+                            bool allLost;
+                            ScoreSteps(board, side == 0 ? Board::FIRST_TAG : Board::SECOND_TAG, fastestWin, longestLoss,
+                                       allLost);
+                            uint8_t expected = 0;
+                            if (fastestWin > 0) {
+                                expected = fastestWin <= MAX_DISTANCE ? (uint8_t)fastestWin : 0;
+                            } else if (allLost && longestLoss <= MAX_DISTANCE) {
+                                expected = (uint8_t)(128 + longestLoss);
+                            }
+                            wrongs[task] += both[side * size + index] != expected;
+                        }
+                    });
+                });
+                uint64_t classWrong = 0;
+                for (uint64_t w: wrongs) {
+                    classWrong += w;
+                }
+                if (log && classWrong > 0) {
+                    fprintf(log, "class %d-%d: %llu boards disagree with their steps\n", f, s,
+                            (unsigned long long)classWrong);
+                }
+                wrong += classWrong;
+            }
+        }
+        return wrong;
+    }
+
+    bool Write(const char* path) const {
+        FILE* file = fopen(path, "wb");
+        if (!file) {
+            return false;
+        }
+        TablebaseHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, TablebaseHeader::MAGIC, 8);
+        header.maxPieces = (uint32_t)maxPieces;
+        uint64_t offset = sizeof(header);
+        for (int f = TablebaseIndex::MIN_PIECES; f <= maxPieces; ++f) {
+            for (int s = TablebaseIndex::MIN_PIECES; s <= maxPieces; ++s) {
+                for (int side = 0; side < 2; ++side) {
+                    header.offsets[f][s][side] = offset;
+                    offset += TablebaseIndex::ClassSize(f, s);
+                }
+            }
+        }
+
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+        for (int f = TablebaseIndex::MIN_PIECES; f <= maxPieces && ok; ++f) {
+            for (int s = TablebaseIndex::MIN_PIECES; s <= maxPieces && ok; ++s) {
+                const vector<uint8_t>& both = values[f][s];
+                ok = fwrite(both.data(), 1, both.size(), file) == both.size();
+            }
+        }
+        return fclose(file) == 0 && ok;
+    }
+private:
+    // Value of the board for playerToMove as stored so far, both sides of a class are kept in one array
+    uint8_t Value(uint32_t first, uint32_t second, int playerToMove) const {
+        int f = __builtin_popcount(first), s = __builtin_popcount(second);
+        const vector<uint8_t>& both = values[f][s];
+        uint64_t size = TablebaseIndex::ClassSize(f, s);
+        return both[TablebaseIndex::Side(playerToMove) * size + TablebaseIndex::Index(first, second)];
+    }
+
+    // The value board gets in pass, 0 if it stays open
+    uint8_t Resolve(Board& board, int playerToMove, int pass) const {
+        int fastestWin, longestLoss;
+        bool allLost;
+        ScoreSteps(board, playerToMove, fastestWin, longestLoss, allLost);
+        if (fastestWin > 0) {
+            // a win slower than pass is still pending, the board must not be taken as lost meanwhile
+            return fastestWin <= pass ? (uint8_t)fastestWin : 0;
+        }
+        if (allLost && longestLoss <= pass) {
+            return (uint8_t)(128 + longestLoss);
+        }
+        return 0;
+    }
+
+    // The steps of board by the values stored so far: the fastest win (0 if none), the longest loss and
+    // whether every step loses
+    void ScoreSteps(Board& board, int playerToMove, int& fastestWin, int& longestLoss, bool& allLost) const {
+        static const int ROUND = 10;
+        fastestWin = 0;
+        longestLoss = 0;
+        allLost = true;
+        MoveList steps;
+        board.FindPossibleSteps(playerToMove, ROUND, steps);
+        for (auto& step: steps) {
+            int winner, distance = -1;
+            bool win = false;
+            StepUndo undo = board.DoStep(step, ROUND);
+            if (board.IsOver(winner, ROUND)) {
+                win = winner == playerToMove;
+                distance = 0;
+            } else {
+                Tablebase::Result result;
+                Tablebase::Decode(Value(board.FindFirst().Mask(), board.FindSecond().Mask(), Board::Opponent(playerToMove)),
+                                  result, distance);
+                if (result == Tablebase::DRAW) {
+                    distance = -1;
+                }
+                win = result == Tablebase::LOSS;
+            }
+            board.UndoStep(undo);
+
+            if (distance < 0) {
+                allLost = false;
+            } else if (win) {
+                allLost = false;
+                fastestWin = fastestWin > 0 ? min(fastestWin, distance + 1) : distance + 1;
+            } else {
+                longestLoss = max(longestLoss, distance + 1);
+            }
+        }
+    }
+
+    void SolveClass(int f, int s, FILE* log) {
+        uint64_t size = TablebaseIndex::ClassSize(f, s);
+        vector<uint8_t>& both = values[f][s];
+        both.assign(2 * size, 0);
+
+        vector<uint32_t> firsts = Firsts(f);
+        size_t taskNumber = TaskNumber();
+        vector<vector<pair<uint64_t, uint8_t>>> found(taskNumber);
+
+        // boards of lower classes resolved late can still open boards of this one at a late pass
+        int lowerDistance = 0;
+        for (int lf = TablebaseIndex::MIN_PIECES; lf <= f; ++lf) {
+            for (int ls = TablebaseIndex::MIN_PIECES; ls <= s; ++ls) {
+                if (lf + ls < f + s) {
+                    for (uint8_t value: values[lf][ls]) {
+                        lowerDistance = max(lowerDistance, value & 127);
+                    }
+                }
+            }
+        }
+
+        uint64_t resolved = 0;
+        for (int pass = 1; pass <= MAX_DISTANCE; ++pass) {
+            RunTasks(taskNumber, [&](size_t task) {
+                found[task].clear();
+                ForEachCanonical(f, s, firsts, task, taskNumber, [&](uint64_t index, uint32_t first, uint32_t second) {
+                    Board board = Board::FromMasks(first, second);
+                    for (int side = 0; side < 2; ++side) {
+                        if (both[side * size + index] != 0) {
+                            continue;
+                        }
+                        uint8_t value = Resolve(board, side == 0 ? Board::FIRST_TAG : Board::SECOND_TAG, pass);
+                        if (value == 0) {
+                            continue;
+                        }
+                        for (int transform = 0; transform < Symmetry::TRANSFORM_NUMBER; ++transform) {
+                            uint64_t image = TablebaseIndex::Index(Symmetry::Mask(transform, first),
+                                                                   Symmetry::Mask(transform, second));
+                            found[task].push_back(make_pair(side * size + image, value));
+                        }
+                    }
+                });
+            });
+
+            uint64_t changed = 0;
+            for (auto& list: found) {
+                for (auto& item: list) {
+                    changed += both[item.first] == 0;
+                    both[item.first] = item.second;
+                }
+            }
+            resolved += changed;
+            if (changed == 0 && pass > lowerDistance + 1) {
+                break;
+            }
+        }
+
+        if (log) {
+            fprintf(log, "class %d-%d: %llu boards, %llu resolved\n", f, s,
+                    (unsigned long long)(2 * size), (unsigned long long)resolved);
+            fflush(log);
+        }
+    }
+
+    // The first piece sets of a class, every task takes a slice of them
+    static vector<uint32_t> Firsts(int f) {
+        vector<uint32_t> firsts;
+        for (uint32_t first = (1u << f) - 1; first <= PosSet::ALL; first = TablebaseIndex::NextSubset(first)) {
+            firsts.push_back(first);
+        }
+        return firsts;
+    }
+
+    size_t TaskNumber() const {
+        return pool ? pool->Size() * 8 : 1;
+    }
+
+    template <typename Task>
+    void RunTasks(size_t taskNumber, const Task& runTask) {
+        if (pool) {
+            for (size_t task = 0; task < taskNumber; ++task) {
+                pool->Submit([&runTask, task](size_t) {
+                    runTask(task);
+                });
+            }
+            pool->Wait();
+        } else {
+            runTask(0);
+        }
+    }
+
+    // Calls visit(index, first, second) for the canonical boards of class f-s in the slice of task
+    template <typename Visit>
+    static void ForEachCanonical(int f, int s, const vector<uint32_t>& firsts, size_t task, size_t taskNumber,
+                                 const Visit& visit) {
+        for (size_t i = task; i < firsts.size(); i += taskNumber) {
+            uint32_t first = firsts[i];
+            uint64_t base = TablebaseIndex::Rank(first) * TablebaseIndex::Binomial(24 - f, s);
+            for (uint32_t compressed = (1u << s) - 1; compressed < (1u << (24 - f));
+                 compressed = TablebaseIndex::NextSubset(compressed)) {
+                uint32_t second = TablebaseIndex::Expand(compressed, first);
+                if (Symmetry::IsCanonical(first, second)) {
+                    visit(base + TablebaseIndex::Rank(compressed), first, second);
+                }
+            }
+        }
+    }
+
+    int maxPieces;
+    unique_ptr<ThreadPool> pool;
+    vector<vector<vector<uint8_t>>> values;     // [first][second], the first to move half then the second to move one
+};
+
+#endif /* tablebase_h */
@@ -0,0 +1,146 @@
+//
+//  threadpool.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef threadpool_h
+#define threadpool_h
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/*
+ A fixed size pool of worker threads. Every worker owns a task deque, tasks are
+ dealt to the deques round robin. A worker pops from the back of its own deque
+ and, once that is empty, steals from the front of the others'.
+ Tasks get the index of the worker running them, so callers can keep per-worker
+ scratch state.
+ */
+class ThreadPool {
+public:
+    typedef function<void(size_t)> Task;
+
+    explicit ThreadPool(size_t threadNumber)
+    :queues(threadNumber), stopping(false), queued(0), pending(0), next(0) {
+        for (size_t i = 0; i < threadNumber; ++i) {
+            workers.emplace_back([this, i] {
+                Work(i);
+            });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(mtx);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        for (auto& worker: workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t Size() const {
+        return workers.size();
+    }
+
+    void Submit(Task task) {
+        size_t target = next++ % queues.size();
+        {
+            // counted before a worker can see it, or it may finish first and wake Wait early
+            lock_guard<mutex> lock(mtx);
+            ++queued;
+            ++pending;
+            lock_guard<mutex> queueLock(queues[target].mtx);
+            queues[target].tasks.push_back(move(task));
+        }
+        wakeup.notify_one();
+    }
+
+    // Block until every submitted task has finished
+    void Wait() {
+        unique_lock<mutex> lock(mtx);
+        done.wait(lock, [this] {
+            return pending == 0;
+        });
+    }
+private:
+    struct Queue {
+        mutex mtx;
+        deque<Task> tasks;
+    };
+
+    bool Pop(size_t self, Task& task) {
+        Queue& queue = queues[self];
+        lock_guard<mutex> lock(queue.mtx);
+        if (queue.tasks.empty()) {
+            return false;
+        }
+        task = move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    bool Steal(size_t self, Task& task) {
+        for (size_t i = 1; i < queues.size(); ++i) {
+            Queue& queue = queues[(self + i) % queues.size()];
+            lock_guard<mutex> lock(queue.mtx);
+            if (!queue.tasks.empty()) {
+                task = move(queue.tasks.front());
+                queue.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Work(size_t self) {
+        while (true) {
+            Task task;
+            if (Pop(self, task) || Steal(self, task)) {
+                {
+                    lock_guard<mutex> lock(mtx);
+                    --queued;
+                }
+                task(self);
+                lock_guard<mutex> lock(mtx);
+                if (--pending == 0) {
+                    done.notify_all();
+                }
+                continue;
+            }
+
+            unique_lock<mutex> lock(mtx);
+            wakeup.wait(lock, [this] {
+                return stopping || queued > 0;
+            });
+            if (stopping && queued == 0) {
+                return;
+            }
+        }
+    }
+
+    vector<thread> workers;
+    vector<Queue> queues;
+    mutex mtx;
+    condition_variable wakeup, done;
+    bool stopping;
+    size_t queued;   // tasks sitting in the deques
+    size_t pending;  // tasks submitted but not finished
+    atomic<size_t> next;
+};
+
+#endif /* threadpool_h */
@@ -0,0 +1,204 @@
+//
+//  ttable.h
+//  chengsan
+//
+//  Created by Garnel Mao on 10/17/26.
+//  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+//
+
+#ifndef ttable_h
+#define ttable_h
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include "step.h"
+
+using namespace std;
+
+/*
+ A fixed size transposition table shared by search threads without locks.
+
+ Every entry is two 64-bit words, (key ^ data, data), written and read with
+ relaxed atomics. A reader accepts an entry only when the two words XOR back to
+ the key it looks for, so an entry torn by a concurrent write just looks like
+ a miss. Entries are grouped 4 to a 64-byte bucket; a store replaces the entry
+ of the same key, or else the shallowest entry, preferring ones left over from
+ earlier searches.
+
+ The statistics are counted in STAT_STRIPES cache lines picked by thread, so
+ the threads of a parallel search do not all write the same line every probe.
+ */
+class TranspositionTable {
+public:
+    enum Bound {
+        NO_BOUND = 0,
+        EXACT = 1,
+        LOWER = 2,      // value is at least the stored one
+        UPPER = 3       // value is at most the stored one
+    };
+
+    struct Entry {
+        Entry()
+        :value(0), move(Step::NONE_CODE), depth(0), bound(NO_BOUND) {
+        }
+
+        int16_t value;
+        uint16_t move;      // Step::Encode() of the best step
+        uint8_t depth;
+        uint8_t bound;
+    };
+
+    struct Stats {
+        uint64_t probes, hits, stores, replacements;
+
+        double HitRate() const {
+            return probes ? (double)hits / probes : 0;
+        }
+    };
+
+    explicit TranspositionTable(size_t megabytes = 16)
+    :buckets(NULL), generation(0) {
+        Resize(megabytes);
+    }
+
+    void Resize(size_t megabytes) {
+        bucketNumber = 1;
+        while (bucketNumber * 2 * sizeof(Bucket) <= megabytes * 1024 * 1024) {
+            bucketNumber *= 2;
+        }
+        // buckets are aligned to cache lines by hand, C++14 new ignores alignas
+        storage.reset(new char[bucketNumber * sizeof(Bucket) + 63]);
+        buckets = reinterpret_cast<Bucket*>(((uintptr_t)storage.get() + 63) & ~(uintptr_t)63);
+        for (size_t i = 0; i < bucketNumber; ++i) {
+            new (&buckets[i]) Bucket();
+        }
+        Clear();
+    }
+
+    void Clear() {
+        for (size_t i = 0; i < bucketNumber; ++i) {
+            for (auto& word: buckets[i].words) {
+                word.store(0, memory_order_relaxed);
+            }
+        }
+        for (auto& stripe: stripes) {
+            stripe.probes = stripe.hits = stripe.stores = stripe.replacements = 0;
+        }
+    }
+
+    // Call before every search, older entries are replaced first
+    void NewSearch() {
+        generation = (generation + 1) & 63;
+    }
+
+    size_t Capacity() const {
+        return bucketNumber * BUCKET_SIZE;
+    }
+
+    bool Probe(uint64_t key, Entry& entry) {
+        StatStripe& stats = Stripe();
+        stats.probes.fetch_add(1, memory_order_relaxed);
+        Bucket& bucket = buckets[key & (bucketNumber - 1)];
+        for (size_t i = 0; i < BUCKET_SIZE; ++i) {
+            uint64_t data = bucket.words[2 * i + 1].load(memory_order_relaxed);
+            if ((bucket.words[2 * i].load(memory_order_relaxed) ^ data) == key && data != 0) {
+                entry = Unpack(data);
+                stats.hits.fetch_add(1, memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Store(uint64_t key, const Entry& entry) {
+        StatStripe& stats = Stripe();
+        stats.stores.fetch_add(1, memory_order_relaxed);
+        Bucket& bucket = buckets[key & (bucketNumber - 1)];
+        size_t victim = 0;
+        int victimScore = INT32_MAX;
+        for (size_t i = 0; i < BUCKET_SIZE; ++i) {
+            uint64_t data = bucket.words[2 * i + 1].load(memory_order_relaxed);
+            if (data == 0 || (bucket.words[2 * i].load(memory_order_relaxed) ^ data) == key) {
+                victim = i;
+                victimScore = -1;
+                break;
+            }
+
+            Entry old = Unpack(data);
+            int score = old.depth + (Generation(data) == generation ? 256 : 0);
+            if (score < victimScore) {
+                victim = i;
+                victimScore = score;
+            }
+        }
+        if (victimScore >= 0) {
+            stats.replacements.fetch_add(1, memory_order_relaxed);
+        }
+
+        uint64_t data = Pack(entry);
+        bucket.words[2 * victim].store(key ^ data, memory_order_relaxed);
+        bucket.words[2 * victim + 1].store(data, memory_order_relaxed);
+    }
+
+    Stats GetStats() const {
+        Stats s = {0, 0, 0, 0};
+        for (auto& stripe: stripes) {
+            s.probes += stripe.probes.load(memory_order_relaxed);
+            s.hits += stripe.hits.load(memory_order_relaxed);
+            s.stores += stripe.stores.load(memory_order_relaxed);
+            s.replacements += stripe.replacements.load(memory_order_relaxed);
+        }
+        return s;
+    }
+private:
+    static const size_t BUCKET_SIZE = 4;
+    static const size_t STAT_STRIPES = 16;
+
+    struct Bucket {
+        atomic<uint64_t> words[2 * BUCKET_SIZE];
+    };
+
+    // Padded to a cache line
+    struct StatStripe {
+        atomic<uint64_t> probes, hits, stores, replacements;
+        char padding[64 - 4 * sizeof(atomic<uint64_t>)];
+    };
+
+    // The stripe of the calling thread, threads take the stripes in turn
+    StatStripe& Stripe() {
+        static atomic<size_t> nextThread(0);
+        thread_local size_t index = nextThread.fetch_add(1, memory_order_relaxed);
+        return stripes[index % STAT_STRIPES];
+    }
+
+    // value:16 | move:16 | depth:8 | bound:2 generation:6, the top 16 bits are free
+    uint64_t Pack(const Entry& entry) const {
+        return (uint64_t)(uint16_t)entry.value
+            | (uint64_t)entry.move << 16
+            | (uint64_t)entry.depth << 32
+            | (uint64_t)((entry.bound & 3) | generation << 2) << 40;
+    }
+
+    static Entry Unpack(uint64_t data) {
+        Entry entry;
+        entry.value = (int16_t)(uint16_t)data;
+        entry.move = (uint16_t)(data >> 16);
+        entry.depth = (uint8_t)(data >> 32);
+        entry.bound = (uint8_t)(data >> 40) & 3;
+        return entry;
+    }
+
+    static int Generation(uint64_t data) {
+        return (int)(data >> 42) & 63;
+    }
+
+    unique_ptr<char[]> storage;
+    Bucket* buckets;
+    size_t bucketNumber;
+    int generation;
+    StatStripe stripes[STAT_STRIPES];
+};
+
+#endif /* ttable_h */
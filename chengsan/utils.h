@@ -10,41 +10,42 @@
 #define utils_h
 
 #include <vector>
-#include <cstdlib>
-#include <ctime>
 #include <algorithm>
-#include <unordered_set>
+#include <cstdint>
+#include "posset.h"
+#include "rng.h"
 
 using namespace std;
 
 struct Utils {
     template<typename T>
-    static T random(const T low, const T high) {
+    static T random(const T low, const T high, Rng& rng) {
         if (low == high) {
             return low;
         }
 
-        return rand() % (high - low + 1) + low;
+        return low + (T)rng.Bounded((uint32_t)(high - low + 1));
     }
     
     template<typename T>
-    static T random(const vector<T>& vec) {
-        return vec[random<size_t>(0, vec.size() - 1)];
+    static T random(const vector<T>& vec, Rng& rng) {
+        return vec[random<size_t>(0, vec.size() - 1, rng)];
     }
     
-    static size_t random(unordered_set<size_t>& s, size_t minBound = 0, size_t maxBound = 23) {
-        size_t r = rand() % (maxBound - minBound + 1) + minBound;
-        auto res = s.insert(r);
-        if (!res.second) {
-            return *s.begin();
-        }
-        auto it = res.first;
-        if (it == s.end()) {
-            it = s.begin();
-        }
-        auto val = *it;
-        s.erase(r);
-        return val;
+    static size_t random(const PosSet& s, Rng& rng) {
+        return rng.PickBit(s.Mask());
+    }
+
+    // splitmix64 finalizer, turns related seeds into unrelated ones
+    static uint64_t Mix(uint64_t x) {
+        x += 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    static uint64_t Mix(uint64_t seed, uint64_t a, uint64_t b = 0, uint64_t c = 0) {
+        return Mix(Mix(Mix(Mix(seed) ^ a) ^ b) ^ c);
     }
 };
 
@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+#
+#  analysis_client.py
+#  chengsan
+#
+#  Created by Garnel Mao on 10/17/26.
+#  Copyright © 2026 maogm12@gmail.com. All rights reserved.
+#
+#  Stands in for the frontend of the analysis service: starts `chengsan serve`,
+#  sends a few positions at once and prints what comes back, see service.h
+#  for the protocol.
+#
+#  usage: analysis_client.py [path to chengsan [threads]]
+#
+
+import subprocess
+import sys
+import threading
+
+POSITIONS = [
+    # id, board, round, side to move, go limits
+    ("empty", "........................", 0, 1, "millis 500"),
+    ("placing", "1.2.1.2.1.2..........1.2", 3, 2, "playouts 5000"),
+    ("moving", "12221112.1.11..2.122.1..", 11, 1, "millis 800"),
+    ("won", "11.1....22.2............", 12, 1, "millis 500"),
+    ("endless", "111.............22.2....", 12, 1, ""),
+]
+
+
+def main():
+    binary = sys.argv[1] if len(sys.argv) > 1 else "chengsan"
+    threads = sys.argv[2] if len(sys.argv) > 2 else "2"
+    engine = subprocess.Popen([binary, "serve", threads], stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                              universal_newlines=True, bufsize=1)
+    pending = set(position[0] for position in POSITIONS)
+    done = threading.Event()
+
+    def read():
+        for line in engine.stdout:
+            print(line.rstrip())
+            words = line.split()
+            if words and words[0] == "bestmove":
+                pending.discard(words[1])
+                if not pending:
+                    done.set()
+        done.set()
+
+    reader = threading.Thread(target=read)
+    reader.start()
+
+    def send(command):
+        engine.stdin.write(command + "\n")
+        engine.stdin.flush()
+
+    for request, board, round, side, limits in POSITIONS:
+        send("position %s %s %d %d" % (request, board, round, side))
+        send("go %s %s" % (request, limits))
+    send("stats")
+
+    # the one without limits runs until it is stopped
+    done.wait(2)
+    send("stop endless")
+    done.wait()
+    send("stats")
+    send("quit")
+    reader.join()
+    engine.wait()
+
+
+if __name__ == "__main__":
+    main()